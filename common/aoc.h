@@ -15,6 +15,8 @@
 #include <numeric>
 #include <array>
 #include <deque>
+#include <bitset>
+#include <memory>
 #include <sstream>
 #include <chrono>
 
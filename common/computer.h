@@ -2,9 +2,45 @@
 
 #include "aoc.h"
 
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <variant>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
 #define CF_HALTED 0x1
 #define CF_PAUSED 0x2
 #define CF_DEFAULT_INPUT 0x4
+#define CF_BLOCKING_IO 0x8
+#define CF_UNTIL_BLOCKED 0x10
+#define CF_NEEDS_INPUT 0x20
+
+/*
+ * Direct-threaded dispatch (one indirect jump per opcode instead of a shared call through the
+ * callback table) needs the GNU labels-as-values extension.
+ */
+#if !defined(AOC_COMPUTER_THREADED_DISPATCH)
+#if defined(__GNUC__) || defined(__clang__)
+#define AOC_COMPUTER_THREADED_DISPATCH 1
+#else
+#define AOC_COMPUTER_THREADED_DISPATCH 0
+#endif
+#endif
+
+/*
+ * Superinstructions: common pairs of instructions get a dispatch slot of their own which runs both
+ * without going back through the dispatcher in between. They only exist in threaded dispatch.
+ */
+#if !defined(AOC_COMPUTER_FUSION)
+#define AOC_COMPUTER_FUSION AOC_COMPUTER_THREADED_DISPATCH
+#endif
 
 namespace aoc {
     namespace detail {
@@ -29,23 +65,1238 @@ namespace aoc {
                     callbacks_[v.opcode] = v.cb;
             }
 
-            inline constexpr cb_t operator[](int code) {
-                assert(size_t(code) < max_entries);
-                return callbacks_[code];
-            }
-            inline constexpr cb_t operator[](int code) const {
-                assert(size_t(code) < max_entries);
-                return callbacks_[code];
+            inline constexpr cb_t operator[](int code) {
+                assert(size_t(code) < max_entries);
+                return callbacks_[code];
+            }
+            inline constexpr cb_t operator[](int code) const {
+                assert(size_t(code) < max_entries);
+                return callbacks_[code];
+            }
+
+        private:
+            cb_t callbacks_[max_entries]{};
+        };
+
+        /*
+         * Sparse word-addressed memory made of 4 KiB pages which are only allocated when first written.
+         * Reads of untouched addresses return 0. Every page slot points either at a page or at a shared
+         * page of zeroes, so reads need no null check; `writable_` holds the same pointers except for
+         * the zero page and for pages shared with a copy, so a null there means the write has to take
+         * the slow path.
+         *
+         * Copies share all pages (copy-on-write): both sides lose write access to them and whichever
+         * writes to a page first gets its own copy of it.
+         */
+        template <typename T>
+        class paged_memory {
+        public:
+            using value_type = T;
+
+            static constexpr const size_t page_bits = 9;
+            static constexpr const size_t page_size = size_t(1) << page_bits;
+            static constexpr const size_t page_mask = page_size - 1;
+            static constexpr const T max_address = T(1) << 32;
+
+            paged_memory() = default;
+            paged_memory(paged_memory&&) = default;
+            paged_memory(const paged_memory& other)
+                : pages_(other.pages_)
+                , readable_(other.readable_)
+                , writable_(other.writable_.size(), nullptr)
+                , size_(other.size_)
+                , baseline_(other.baseline_)
+                , dirty_(other.dirty_)
+                , dirty_pages_(other.dirty_pages_)
+            {
+                std::fill(other.writable_.begin(), other.writable_.end(), nullptr);
+            }
+
+            paged_memory& operator=(paged_memory&&) = default;
+            paged_memory& operator=(const paged_memory& other) {
+                if (this != &other)
+                    *this = paged_memory(other);
+                return *this;
+            }
+
+            /* one past the highest address that was ever loaded, written or reserved */
+            inline size_t size() const {
+                return size_;
+            }
+            inline bool empty() const {
+                return !size_;
+            }
+
+            inline T read(T address) const {
+                auto page = size_t(address) >> page_bits;
+                if (page < readable_.size())
+                    return readable_[page][size_t(address) & page_mask];
+                check(address);
+                return 0;
+            }
+            inline T operator[](size_t address) const {
+                return read(T(address));
+            }
+            /* only for addresses below what map() covers */
+            inline T read_unchecked(T address) const {
+                return readable_[size_t(address) >> page_bits][size_t(address) & page_mask];
+            }
+
+            inline void write(T address, T value) {
+                ref(address) = value;
+            }
+            inline T& ref(T address) {
+                auto page = size_t(address) >> page_bits;
+                if (page >= writable_.size() || !writable_[page]) {
+                    check(address);
+                    make_writable(page);
+                }
+                if (size_t(address) >= size_)
+                    size_ = size_t(address) + 1;
+                return writable_[page][size_t(address) & page_mask];
+            }
+
+            inline T& ref_unchecked(T address) {
+                auto page = size_t(address) >> page_bits;
+                if (!writable_[page])
+                    make_writable(page);
+                size_ = std::max(size_, size_t(address) + 1);
+                return writable_[page][size_t(address) & page_mask];
+            }
+
+            inline void push_back(T value) {
+                write(T(size_), value);
+            }
+
+            /* makes the page tables cover [0, size) so the unchecked accessors can be used there */
+            void map(size_t size) {
+                auto count = (size + page_mask) >> page_bits;
+                if (count > pages_.size()) {
+                    pages_.resize(count);
+                    readable_.resize(count, zero_page());
+                    writable_.resize(count, nullptr);
+                }
+            }
+
+            /* extends size() without allocating anything */
+            inline void reserve(size_t size) {
+                size_ = std::max(size_, size);
+            }
+
+            /* zeroes [address, address + count) without allocating pages that are not there yet */
+            void fill_zero(size_t address, size_t count) {
+                auto last = address + count;
+                while (address < last) {
+                    auto page = address >> page_bits;
+                    auto page_end = std::min(last, (page + 1) << page_bits);
+                    if (page < pages_.size() && pages_[page]) {
+                        if (!writable_[page])
+                            make_writable(page);
+                        std::fill(writable_[page] + (address & page_mask), writable_[page] + (page_end - (page << page_bits)), T(0));
+                    }
+                    address = page_end;
+                }
+            }
+
+            inline void clear() {
+                pages_.clear();
+                readable_.clear();
+                writable_.clear();
+                size_ = 0;
+                baseline_.reset();
+                dirty_.clear();
+                dirty_pages_.clear();
+            }
+
+            /* remembers the current contents, from here on the pages that get written are tracked */
+            void set_baseline() {
+                baseline_ = std::make_shared<const baseline_t>(baseline_t{pages_, size_});
+                std::fill(writable_.begin(), writable_.end(), nullptr);
+                dirty_.assign(pages_.size(), 0);
+                dirty_pages_.clear();
+            }
+            inline bool has_baseline() const {
+                return bool(baseline_);
+            }
+
+            /* puts the baseline back into every page written since, calling `on_change(address)` per word that differed */
+            template <typename F>
+            void restore_baseline(F&& on_change) {
+                for (auto page : dirty_pages_) {
+                    dirty_[page] = 0;
+                    const auto* src = page < baseline_->pages.size() && baseline_->pages[page]
+                                    ? baseline_->pages[page].get() : zero_page();
+                    auto& p = pages_[page];
+                    auto first = page << page_bits;
+                    if (p.use_count() > 1) {
+                        /* shared with a fork, go back to sharing the baseline page instead */
+                        for (size_t idx = 0; idx < page_size; idx++) {
+                            if (p[idx] != src[idx])
+                                on_change(first + idx);
+                        }
+                        p = page < baseline_->pages.size() ? baseline_->pages[page] : nullptr;
+                        readable_[page] = src;
+                    } else {
+                        /* keep the private page so the next write does not need a new one */
+                        for (size_t idx = 0; idx < page_size; idx++) {
+                            if (p[idx] != src[idx]) {
+                                p[idx] = src[idx];
+                                on_change(first + idx);
+                            }
+                        }
+                    }
+                    writable_[page] = nullptr;
+                }
+                dirty_pages_.clear();
+                size_ = baseline_->size;
+            }
+
+            std::vector<T> to_vector() const {
+                std::vector<T> ret(size_);
+                for (size_t idx = 0; idx < size_; idx++)
+                    ret[idx] = read(T(idx));
+                return ret;
+            }
+
+            /* becomes a copy of `other`, calling `on_change(page)` for every page whose contents may differ */
+            template <typename F>
+            void assign(const paged_memory& other, F&& on_change) {
+                for (size_t page = 0; page < std::max(readable_.size(), other.readable_.size()); page++) {
+                    auto* mine = page < readable_.size() ? readable_[page] : zero_page();
+                    auto* theirs = page < other.readable_.size() ? other.readable_[page] : zero_page();
+                    if (mine != theirs)
+                        on_change(page);
+                }
+                *this = other;
+            }
+
+            /* calls `fn(page, words)` for every page that has been allocated */
+            template <typename F>
+            void for_each_page(F&& fn) const {
+                for (size_t page = 0; page < pages_.size(); page++) {
+                    if (pages_[page])
+                        fn(page, static_cast<const T*>(pages_[page].get()));
+                }
+            }
+
+            /*
+             * Replaces the contents with `count` pages of page_size words found at `data` and kept alive by
+             * `owner`, the i-th of which goes to page `index[i]`. They are used in place and shared like a
+             * fork's, so the first write to one of them takes a private copy.
+             */
+            void adopt(const std::shared_ptr<void>& owner, const uint64_t* index, T* data, size_t count, size_t size) {
+                clear();
+                for (size_t idx = 0; idx < count; idx++) {
+                    auto page = size_t(index[idx]);
+                    if (page >= pages_.size()) {
+                        pages_.resize(page + 1);
+                        readable_.resize(page + 1, zero_page());
+                        writable_.resize(page + 1, nullptr);
+                    }
+                    pages_[page] = std::shared_ptr<T[]>(owner, data + idx * page_size);
+                    readable_[page] = pages_[page].get();
+                }
+                size_ = size;
+            }
+
+            /* page tables for code that inlines the lookup */
+            inline const T* const* readable_pages() const {
+                return readable_.data();
+            }
+            inline T* const* writable_pages() const {
+                return writable_.data();
+            }
+            inline size_t page_count() const {
+                return readable_.size();
+            }
+
+        private:
+            static inline const T* zero_page() {
+                static const T zeroes[page_size]{};
+                return zeroes;
+            }
+
+            static inline void check(T address) {
+                if (address < 0 || address >= max_address) {
+                    fmt::print(::stderr, "INVALID MEMORY ADDRESS: {}\n", address);
+                    std::abort();
+                }
+            }
+
+            /* allocates a missing page or takes a private copy of a shared one */
+            void make_writable(size_t page) {
+                if (page >= pages_.size()) {
+                    pages_.resize(page + 1);
+                    readable_.resize(page + 1, zero_page());
+                    writable_.resize(page + 1, nullptr);
+                }
+                auto& p = pages_[page];
+                if (!p) {
+                    p = std::shared_ptr<T[]>(new T[page_size]());
+                } else if (p.use_count() > 1) {
+                    auto copy = std::shared_ptr<T[]>(new T[page_size]);
+                    std::copy(p.get(), p.get() + page_size, copy.get());
+                    p = std::move(copy);
+                }
+                readable_[page] = writable_[page] = p.get();
+                if (baseline_) {
+                    if (dirty_.size() <= page)
+                        dirty_.resize(page + 1, 0);
+                    if (!dirty_[page]) {
+                        dirty_[page] = 1;
+                        dirty_pages_.push_back(page);
+                    }
+                }
+            }
+
+            struct baseline_t {
+                std::vector<std::shared_ptr<T[]>> pages;
+                size_t size;
+            };
+
+            std::vector<std::shared_ptr<T[]>> pages_{};
+            std::vector<const T*> readable_{};
+            /* mutable so that copying from a const source can revoke its write access as well */
+            mutable std::vector<T*> writable_{};
+            size_t size_{0};
+            std::shared_ptr<const baseline_t> baseline_{};
+            std::vector<uint8_t> dirty_{};
+            std::vector<size_t> dirty_pages_{};
+        };
+
+        /*
+         * Power-of-two ring buffer used for the computer's I/O. One thread may push (try_push) while
+         * another pops (try_pop) without locking; everything else, including push_back() which grows a
+         * full buffer, is for single-threaded use.
+         */
+        template <typename T>
+        class ring_buffer {
+        public:
+            using value_type = T;
+
+            static constexpr const size_t default_capacity = 64;
+
+            class const_iterator {
+            public:
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = T;
+                using difference_type = ptrdiff_t;
+                using pointer = const T*;
+                using reference = const T&;
+
+                const_iterator(const ring_buffer* rb, size_t idx) : rb_(rb), idx_(idx) {}
+                inline const T& operator*() const { return rb_->data_[idx_ & rb_->mask_]; }
+                inline const_iterator& operator++() { idx_++; return *this; }
+                inline const_iterator operator++(int) { auto ret = *this; idx_++; return ret; }
+                inline bool operator==(const const_iterator& other) const { return idx_ == other.idx_; }
+                inline bool operator!=(const const_iterator& other) const { return idx_ != other.idx_; }
+
+            private:
+                const ring_buffer* rb_;
+                size_t idx_;
+            };
+
+            explicit ring_buffer(size_t capacity = default_capacity)
+                : data_(round_up(capacity))
+                , mask_(data_.size() - 1)
+            {}
+            ring_buffer(const ring_buffer& other)
+                : data_(other.data_.size())
+                , mask_(other.mask_)
+            {
+                size_t count{0};
+                for (auto v : other)
+                    data_[count++] = v;
+                tail_.store(count, std::memory_order_relaxed);
+            }
+            ring_buffer(ring_buffer&& other) noexcept
+                : data_(std::move(other.data_))
+                , mask_(other.mask_)
+                , head_(other.head_.load(std::memory_order_relaxed))
+                , tail_(other.tail_.load(std::memory_order_relaxed))
+            {}
+            ring_buffer& operator=(const ring_buffer& other) {
+                if (this != &other)
+                    *this = ring_buffer(other);
+                return *this;
+            }
+            ring_buffer& operator=(ring_buffer&& other) noexcept {
+                data_ = std::move(other.data_);
+                mask_ = other.mask_;
+                head_.store(other.head_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                tail_.store(other.tail_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                return *this;
+            }
+
+            inline size_t size() const {
+                return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+            }
+            inline bool empty() const {
+                return !size();
+            }
+            inline size_t capacity() const {
+                return data_.size();
+            }
+
+            inline const T& front() const {
+                return data_[head_.load(std::memory_order_relaxed) & mask_];
+            }
+            inline const T& back() const {
+                return data_[(tail_.load(std::memory_order_relaxed) - 1) & mask_];
+            }
+            inline const T& operator[](size_t idx) const {
+                return data_[(head_.load(std::memory_order_relaxed) + idx) & mask_];
+            }
+            inline const_iterator begin() const {
+                return {this, head_.load(std::memory_order_acquire)};
+            }
+            inline const_iterator end() const {
+                return {this, tail_.load(std::memory_order_acquire)};
+            }
+
+            /* producer side */
+            inline bool try_push(T v) {
+                auto tail = tail_.load(std::memory_order_relaxed);
+                if (tail - head_.load(std::memory_order_acquire) == data_.size())
+                    return false;
+                data_[tail & mask_] = v;
+                tail_.store(tail + 1, std::memory_order_release);
+                return true;
+            }
+            /* consumer side */
+            inline std::optional<T> try_pop() {
+                auto head = head_.load(std::memory_order_relaxed);
+                if (head == tail_.load(std::memory_order_acquire))
+                    return std::nullopt;
+                auto ret = data_[head & mask_];
+                head_.store(head + 1, std::memory_order_release);
+                return ret;
+            }
+
+            inline void push_back(T v) {
+                if (!try_push(v)) {
+                    reallocate(data_.size() * 2);
+                    try_push(v);
+                }
+            }
+            inline void reserve(size_t capacity) {
+                if (capacity > data_.size())
+                    reallocate(round_up(capacity));
+            }
+            inline void pop_front() {
+                head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            }
+            inline void clear() {
+                head_.store(tail_.load(std::memory_order_acquire), std::memory_order_release);
+            }
+
+        private:
+            static inline size_t round_up(size_t capacity) {
+                size_t ret{1};
+                while (ret < capacity)
+                    ret <<= 1;
+                return ret;
+            }
+
+            void reallocate(size_t capacity) {
+                std::vector<T> data(capacity);
+                size_t count{0};
+                for (auto v : *this)
+                    data[count++] = v;
+                data_ = std::move(data);
+                mask_ = data_.size() - 1;
+                head_.store(0, std::memory_order_relaxed);
+                tail_.store(count, std::memory_order_relaxed);
+            }
+
+            std::vector<T> data_;
+            size_t mask_;
+            /* consumer and producer indices live on their own cache lines */
+            alignas(64) std::atomic<size_t> head_{0};
+            alignas(64) std::atomic<size_t> tail_{0};
+        };
+
+        /* atomic bool which copies by value, so that whatever holds one stays copyable */
+        class shared_flag {
+        public:
+            shared_flag() = default;
+            shared_flag(const shared_flag& other) : value_(other.load()) {}
+            shared_flag& operator=(const shared_flag& other) {
+                store(other.load());
+                return *this;
+            }
+
+            inline bool load() const { return value_.load(std::memory_order_acquire); }
+            inline void store(bool v) { value_.store(v, std::memory_order_release); }
+
+        private:
+            std::atomic<bool> value_{false};
+        };
+
+        /* owning pointer which deep-copies through T::clone() */
+        template <typename T>
+        class cloning_ptr {
+        public:
+            cloning_ptr() = default;
+            cloning_ptr(std::unique_ptr<T> ptr) : ptr_(std::move(ptr)) {}
+            cloning_ptr(cloning_ptr&&) = default;
+            cloning_ptr(const cloning_ptr& other) : ptr_(other.ptr_ ? other.ptr_->clone() : nullptr) {}
+
+            cloning_ptr& operator=(cloning_ptr&&) = default;
+            cloning_ptr& operator=(const cloning_ptr& other) {
+                if (this != &other)
+                    ptr_ = other.ptr_ ? other.ptr_->clone() : nullptr;
+                return *this;
+            }
+
+            inline T* get() const { return ptr_.get(); }
+            inline T* operator->() const { return ptr_.get(); }
+            inline explicit operator bool() const { return bool(ptr_); }
+
+        private:
+            std::unique_ptr<T> ptr_{};
+        };
+
+        /* a file mapped into memory whole: read-only, or writable and grown on demand */
+        class mapped_file {
+        public:
+            mapped_file() = default;
+            mapped_file(const mapped_file&) = delete;
+            mapped_file(mapped_file&& other) noexcept {
+                swap(other);
+            }
+            mapped_file& operator=(const mapped_file&) = delete;
+            mapped_file& operator=(mapped_file&& other) noexcept {
+                mapped_file tmp{std::move(other)};
+                swap(tmp);
+                return *this;
+            }
+            ~mapped_file() {
+                close();
+            }
+
+            bool create(const std::string& path, size_t size) {
+                close();
+                fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+                if (fd_ < 0 || ::ftruncate(fd_, off_t(size)))
+                    return fail();
+                data_ = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+                size_ = size;
+                writable_ = true;
+                return data_ != MAP_FAILED || fail();
+            }
+            /* with `copy_on_write` the mapping may be written to, which never reaches the file */
+            bool open(const std::string& path, bool copy_on_write = false) {
+                close();
+                struct stat st{};
+                fd_ = ::open(path.c_str(), O_RDONLY);
+                if (fd_ < 0 || ::fstat(fd_, &st))
+                    return fail();
+                size_ = size_t(st.st_size);
+                auto prot = PROT_READ | (copy_on_write ? PROT_WRITE : 0);
+                data_ = size_ ? ::mmap(nullptr, size_, prot, MAP_PRIVATE, fd_, 0) : nullptr;
+                return data_ != MAP_FAILED || fail();
+            }
+            bool resize(size_t size) {
+                if (::ftruncate(fd_, off_t(size)))
+                    return false;
+                auto data = ::mremap(data_, size_, size, MREMAP_MAYMOVE);
+                if (data == MAP_FAILED)
+                    return false;
+                data_ = data;
+                size_ = size;
+                return true;
+            }
+            /* a writable file is cut down to its first `length` bytes */
+            void close(size_t length = size_t(-1)) {
+                if (data_ && data_ != MAP_FAILED)
+                    ::munmap(data_, size_);
+                if (fd_ >= 0) {
+                    if (writable_ && length < size_ && ::ftruncate(fd_, off_t(length)))
+                        fmt::print(::stderr, "CANNOT TRUNCATE MAPPED FILE: {}\n", std::strerror(errno));
+                    ::close(fd_);
+                }
+                data_ = nullptr;
+                size_ = 0;
+                fd_ = -1;
+                writable_ = false;
+            }
+
+            inline bool is_open() const {
+                return fd_ >= 0;
+            }
+            inline uint8_t* data() const {
+                return static_cast<uint8_t*>(data_);
+            }
+            inline size_t size() const {
+                return size_;
+            }
+
+        private:
+            bool fail() {
+                auto err = errno;
+                if (data_ == MAP_FAILED)
+                    data_ = nullptr;
+                close();
+                errno = err;
+                return false;
+            }
+            void swap(mapped_file& other) {
+                std::swap(data_, other.data_);
+                std::swap(size_, other.size_);
+                std::swap(fd_, other.fd_);
+                std::swap(writable_, other.writable_);
+            }
+
+            void* data_{nullptr};
+            size_t size_{0};
+            int fd_{-1};
+            bool writable_{false};
+        };
+
+        /* LEB128 of zigzag-encoded values, so small magnitudes of either sign take a single byte */
+        inline constexpr uint64_t zigzag(int64_t v) {
+            return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+        }
+        inline constexpr int64_t unzigzag(uint64_t v) {
+            return int64_t(v >> 1) ^ -int64_t(v & 1);
+        }
+        inline uint8_t* put_varint(uint8_t* out, uint64_t v) {
+            while (v >= 0x80) {
+                *out++ = uint8_t(v | 0x80);
+                v >>= 7;
+            }
+            *out++ = uint8_t(v);
+            return out;
+        }
+        /* false on a truncated value */
+        inline bool get_varint(const uint8_t*& in, const uint8_t* end, uint64_t& v) {
+            v = 0;
+            for (unsigned shift = 0; in < end && shift < 64; shift += 7) {
+                auto byte = *in++;
+                v |= uint64_t(byte & 0x7f) << shift;
+                if (!(byte & 0x80))
+                    return true;
+            }
+            return false;
+        }
+    }
+
+    /*
+     * What profiling_policy collects: executions per opcode, per opcode and addressing mode combination
+     * and per IP, reads and writes per memory address and the host time spent per opcode (measured from
+     * the fetch of one instruction to the fetch of the next one, so it includes dispatch). Only
+     * interpreted instructions are seen; an accelerator hides whatever it runs.
+     */
+    class execution_profile {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        /* opcodes 0 to 99 and the one past them decode() turns anything it does not know into */
+        static constexpr const size_t max_opcode = 101;
+        static constexpr const size_t mode_combinations = 27;
+
+        inline void instruction(size_t ip, uint8_t code, uint8_t length, const std::array<uint8_t, 3>& modes) {
+            auto now = clock::now();
+            stop(now);
+            running_ = code;
+            started_ = now;
+            opcodes_[code] += 1;
+            /* digits past the last parameter mean nothing; an invalid mode aborts before the instruction does anything */
+            size_t combination{0};
+            bool valid{true};
+            for (size_t p = 0, scale = 1; p + 1 < length; p++, scale *= 3) {
+                valid = valid && modes[p] < 3;
+                combination += modes[p] * scale;
+            }
+            if (valid)
+                modes_[code][combination] += 1;
+            bump(ips_, ip);
+        }
+        /* ends the timing of the instruction that is currently running */
+        inline void stop(clock::time_point now = clock::now()) {
+            if (running_ < max_opcode)
+                nanoseconds_[running_] += uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(now - started_).count());
+            running_ = max_opcode;
+        }
+        inline void read(size_t address) {
+            bump(reads_, address);
+        }
+        inline void write(size_t address) {
+            bump(writes_, address);
+        }
+
+        void clear() {
+            *this = execution_profile{};
+        }
+
+        /* the `top` hottest entries of every table */
+        void report(std::FILE* out = stderr, size_t top = 10) const {
+            uint64_t total{0}, total_ns{0};
+            for (size_t code = 0; code < max_opcode; code++) {
+                total += opcodes_[code];
+                total_ns += nanoseconds_[code];
+            }
+            fmt::print(out, "{} instructions, {:.3f} ms\n", total, double(total_ns) / 1e6);
+
+            fmt::print(out, "\nopcode class       count      %    ns total    ns/op\n");
+            for (const auto& [name, count, ns] : by_class()) {
+                if (count)
+                    fmt::print(out, "{:<14} {:>9} {:>6.2f} {:>11} {:>8.1f}\n", name, count, percent(count, total), ns, double(ns) / double(count));
+            }
+
+            fmt::print(out, "\nopcode             count      %    ns total    ns/op\n");
+            for (auto code : sorted(opcodes_.data(), max_opcode, max_opcode)) {
+                fmt::print(out, "{:<14} {:>9} {:>6.2f} {:>11} {:>8.1f}\n", opcode_name(code), opcodes_[code], percent(opcodes_[code], total),
+                           nanoseconds_[code], double(nanoseconds_[code]) / double(opcodes_[code]));
+            }
+
+            std::vector<uint64_t> modes(max_opcode * mode_combinations);
+            for (size_t code = 0; code < max_opcode; code++)
+                std::copy(modes_[code].begin(), modes_[code].end(), modes.begin() + ptrdiff_t(code * mode_combinations));
+            fmt::print(out, "\nopcode/modes       count      %\n");
+            for (auto idx : sorted(modes.data(), modes.size(), top)) {
+                fmt::print(out, "{:<8} {} {:>9} {:>6.2f}\n", opcode_name(idx / mode_combinations), mode_name(idx % mode_combinations),
+                           modes[idx], percent(modes[idx], total));
+            }
+
+            fmt::print(out, "\nip                 count      %\n");
+            for (auto ip : sorted(ips_.data(), ips_.size(), top))
+                fmt::print(out, "{:<14} {:>9} {:>6.2f}\n", ip, ips_[ip], percent(ips_[ip], total));
+
+            auto heat = memory_heat();
+            fmt::print(out, "\naddress            reads     writes\n");
+            for (auto addr : sorted(heat.data(), heat.size(), top))
+                fmt::print(out, "{:<14} {:>9} {:>9}\n", addr, at(reads_, addr), at(writes_, addr));
+        }
+
+        /* one row per non-zero counter: kind,key,count,reads,writes,nanoseconds */
+        void write_csv(std::ostream& out) const {
+            out << "kind,key,count,reads,writes,nanoseconds\n";
+            for (size_t code = 0; code < max_opcode; code++) {
+                if (opcodes_[code])
+                    out << "opcode," << opcode_name(code) << ',' << opcodes_[code] << ",,," << nanoseconds_[code] << '\n';
+            }
+            for (const auto& [name, count, ns] : by_class()) {
+                if (count)
+                    out << "class," << name << ',' << count << ",,," << ns << '\n';
+            }
+            for (size_t code = 0; code < max_opcode; code++) {
+                for (size_t m = 0; m < mode_combinations; m++) {
+                    if (modes_[code][m])
+                        out << "modes," << opcode_name(code) << ' ' << mode_name(m) << ',' << modes_[code][m] << ",,,\n";
+                }
+            }
+            for (size_t ip = 0; ip < ips_.size(); ip++) {
+                if (ips_[ip])
+                    out << "ip," << ip << ',' << ips_[ip] << ",,,\n";
+            }
+            for (size_t addr = 0; addr < std::max(reads_.size(), writes_.size()); addr++) {
+                if (at(reads_, addr) || at(writes_, addr))
+                    out << "memory," << addr << ",," << at(reads_, addr) << ',' << at(writes_, addr) << ",\n";
+            }
+        }
+
+        inline uint64_t executions(size_t code) const {
+            return code < max_opcode ? opcodes_[code] : 0;
+        }
+        inline uint64_t executions_at(size_t ip) const {
+            return at(ips_, ip);
+        }
+        inline uint64_t reads(size_t address) const {
+            return at(reads_, address);
+        }
+        inline uint64_t writes(size_t address) const {
+            return at(writes_, address);
+        }
+
+        static std::string opcode_name(size_t code) {
+            static constexpr const char* names[] = {"?", "ADD", "MUL", "IN", "OUT", "JNZ", "JZ", "LT", "EQ", "SRB"};
+            if (code < std::size(names))
+                return names[code];
+            return code == 99 ? "HLT" : fmt::format("INVAL({})", code);
+        }
+
+    private:
+        struct class_entry {
+            const char* name;
+            uint64_t count;
+            uint64_t ns;
+        };
+
+        static inline void bump(std::vector<uint64_t>& v, size_t idx) {
+            if (idx >= v.size())
+                v.resize(std::max(idx + 1, v.size() * 2));
+            v[idx] += 1;
+        }
+        static inline uint64_t at(const std::vector<uint64_t>& v, size_t idx) {
+            return idx < v.size() ? v[idx] : 0;
+        }
+        static inline double percent(uint64_t count, uint64_t total) {
+            return total ? 100.0 * double(count) / double(total) : 0.0;
+        }
+
+        /* indices of the `top` largest non-zero counters, largest first */
+        static std::vector<size_t> sorted(const uint64_t* counts, size_t size, size_t top) {
+            std::vector<size_t> ret{};
+            for (size_t idx = 0; idx < size; idx++) {
+                if (counts[idx])
+                    ret.push_back(idx);
+            }
+            std::stable_sort(ret.begin(), ret.end(), [counts](size_t a, size_t b) { return counts[a] > counts[b]; });
+            if (ret.size() > top)
+                ret.resize(top);
+            return ret;
+        }
+
+        static std::string mode_name(size_t combination) {
+            static constexpr const char modes[] = {'P', 'I', 'R'};
+            return {modes[combination % 3], modes[combination / 3 % 3], modes[combination / 9]};
+        }
+
+        std::array<class_entry, 6> by_class() const {
+            auto sum = [this](std::initializer_list<size_t> codes) {
+                class_entry ret{"", 0, 0};
+                for (auto code : codes) {
+                    ret.count += opcodes_[code];
+                    ret.ns += nanoseconds_[code];
+                }
+                return ret;
+            };
+            std::array<class_entry, 6> ret{sum({1, 2}), sum({7, 8}), sum({5, 6}), sum({3, 4}), sum({9}), sum({0, 99})};
+            const char* names[] = {"arithmetic", "compare", "jump", "i/o", "relbase", "other"};
+            for (size_t idx = 0; idx < ret.size(); idx++)
+                ret[idx].name = names[idx];
+            return ret;
+        }
+
+        std::vector<uint64_t> memory_heat() const {
+            std::vector<uint64_t> ret(std::max(reads_.size(), writes_.size()));
+            for (size_t addr = 0; addr < ret.size(); addr++)
+                ret[addr] = at(reads_, addr) + at(writes_, addr);
+            return ret;
+        }
+
+        std::array<uint64_t, max_opcode> opcodes_{};
+        std::array<uint64_t, max_opcode> nanoseconds_{};
+        std::array<std::array<uint64_t, mode_combinations>, max_opcode> modes_{};
+        std::vector<uint64_t> ips_{};
+        std::vector<uint64_t> reads_{};
+        std::vector<uint64_t> writes_{};
+        size_t running_{max_opcode};
+        clock::time_point started_{};
+    };
+
+    /*
+     * What sampling_policy collects: every `period` interpreted instructions, and on every SIGPROF tick
+     * while start_timer() is in effect, the running opcode and the basic block (entered by a jump or by
+     * falling off the end of the previous instruction's run) it belongs to are recorded together with the
+     * current call stack. The code these programs are compiled from calls a function by jumping to it and
+     * the function starts with SRB +frame, returning with SRB -frame followed by a jump through the
+     * relative base, so the stack is rebuilt from relative base changes alone: going up pushes a frame
+     * named after the SRB, coming back down pops every frame opened above the new base.
+     */
+    class execution_sampler {
+    public:
+        static constexpr const uint64_t default_period = 1009;
+
+        /* sample every `period` instructions; 0 leaves only the timer */
+        inline void every(uint64_t period) {
+            period_ = period;
+            countdown_ = period ? period : std::numeric_limits<uint64_t>::max();
+        }
+
+        /* there is only one SIGPROF timer per process; whichever sampler runs next takes each tick */
+        static void start_timer(std::chrono::microseconds interval) {
+            struct sigaction sa{};
+            sa.sa_handler = [](int) { tick_.store(true, std::memory_order_relaxed); };
+            sa.sa_flags = SA_RESTART;
+            sigemptyset(&sa.sa_mask);
+            sigaction(SIGPROF, &sa, nullptr);
+            itimerval timer{};
+            timer.it_interval.tv_sec = time_t(interval.count() / 1000000);
+            timer.it_interval.tv_usec = suseconds_t(interval.count() % 1000000);
+            timer.it_value = timer.it_interval;
+            setitimer(ITIMER_PROF, &timer, nullptr);
+        }
+        static void stop_timer() {
+            itimerval timer{};
+            setitimer(ITIMER_PROF, &timer, nullptr);
+            signal(SIGPROF, SIG_IGN);
+            tick_.store(false, std::memory_order_relaxed);
+        }
+
+        inline void instruction(size_t ip, uint8_t code, uint8_t length, int64_t relbase) {
+            if (ip != next_)
+                block_ = ip;
+            next_ = ip + length;
+            if (relbase != relbase_) [[unlikely]]
+                frame(relbase);
+            if (!--countdown_ || tick_.load(std::memory_order_relaxed)) [[unlikely]]
+                sample(code);
+            last_ = ip;
+        }
+
+        void clear() {
+            stacks_.clear();
+            opcodes_.fill(0);
+            samples_ = 0;
+        }
+
+        inline uint64_t samples() const {
+            return samples_;
+        }
+
+        /* one `frame;frame;...;block count` line per distinct stack, as flamegraph.pl and friends take them */
+        void write_folded(std::ostream& out) const {
+            for (const auto& [stack, count] : stacks_) {
+                out << "intcode";
+                for (size_t idx = 0; idx + 1 < stack.size(); idx++)
+                    out << ";fn_" << stack[idx];
+                out << ";block_" << stack.back() << ' ' << count << '\n';
+            }
+        }
+
+        void report(std::FILE* out = stderr, size_t top = 10) const {
+            fmt::print(out, "{} samples\n", samples_);
+            std::map<size_t, uint64_t> blocks{};
+            for (const auto& [stack, count] : stacks_)
+                blocks[stack.back()] += count;
+            std::vector<std::pair<size_t, uint64_t>> hot(blocks.begin(), blocks.end());
+            std::stable_sort(hot.begin(), hot.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+            fmt::print(out, "\nblock              samples      %\n");
+            for (size_t idx = 0; idx < std::min(top, hot.size()); idx++)
+                fmt::print(out, "{:<14} {:>11} {:>6.2f}\n", hot[idx].first, hot[idx].second, 100.0 * double(hot[idx].second) / double(samples_));
+            fmt::print(out, "\nopcode           samples      %\n");
+            for (size_t code = 0; code < opcodes_.size(); code++) {
+                if (opcodes_[code])
+                    fmt::print(out, "{:<14} {:>11} {:>6.2f}\n", execution_profile::opcode_name(code), opcodes_[code],
+                               100.0 * double(opcodes_[code]) / double(samples_));
+            }
+        }
+
+    private:
+        struct frame_t {
+            size_t entry;
+            int64_t relbase;
+        };
+
+        void frame(int64_t relbase) {
+            /* an SRB that does not start a block it was jumped to is a local adjustment, not a call */
+            if (relbase > relbase_ && last_ == block_) {
+                frames_.push_back({last_, relbase_});
+            } else if (relbase < relbase_) {
+                while (!frames_.empty() && frames_.back().relbase >= relbase)
+                    frames_.pop_back();
+            }
+            relbase_ = relbase;
+        }
+
+        void sample(uint8_t code) {
+            tick_.store(false, std::memory_order_relaxed);
+            countdown_ = period_ ? period_ : std::numeric_limits<uint64_t>::max();
+            samples_ += 1;
+            opcodes_[code] += 1;
+            key_.clear();
+            for (const auto& f : frames_)
+                key_.push_back(f.entry);
+            key_.push_back(block_);
+            stacks_[key_] += 1;
+        }
+
+        static inline std::atomic<bool> tick_{false};
+        static_assert(std::atomic<bool>::is_always_lock_free);
+
+        uint64_t period_{default_period};
+        uint64_t countdown_{default_period};
+        size_t next_{0};
+        size_t block_{0};
+        size_t last_{0};
+        int64_t relbase_{0};
+        std::vector<frame_t> frames_{};
+        std::vector<size_t> key_{};
+        std::map<std::vector<size_t>, uint64_t> stacks_{};
+        std::array<uint64_t, execution_profile::max_opcode> opcodes_{};
+        uint64_t samples_{0};
+    };
+
+    /*
+     * What recording_policy writes to a trace file between start_trace() and stop_trace(). The file is
+     * mapped and grown in place, so recording an event is a bounds check and a few byte stores. After a
+     * header holding the memory image and registers the trace is a stream of varints:
+     *
+     *   step:    zigzag(ip - ip_after_previous) << 1 | 1      once per instruction, before its effects
+     *   event:   kind << 1, then its operands                EK_WRITE address delta, value
+     *                                                       EK_RELBASE delta, EK_INPUT / EK_OUTPUT value
+     *                                                       EK_END ip delta (the IP when recording stopped)
+     *
+     * A zero byte is neither, which is what the unused tail of a trace that was never stopped holds.
+     * Only what the interpreter does is recorded: writes made through mem_ref() and whatever an
+     * accelerator runs never make it into the trace. See computer_trace.h for reading one back.
+     */
+    class trace_recorder {
+    public:
+        static constexpr const char magic[8] = {'A', 'O', 'C', 'T', 'R', 'A', 'C', 'E'};
+        static constexpr const uint64_t version = 1;
+
+        enum event_kind : uint8_t {
+            EK_NONE,
+            EK_WRITE,
+            EK_RELBASE,
+            EK_INPUT,
+            EK_OUTPUT,
+            EK_END,
+        };
+
+        trace_recorder() = default;
+        trace_recorder(trace_recorder&& other) noexcept {
+            swap(other);
+        }
+        /* a copy of a recording computer does not write to its source's trace */
+        trace_recorder(const trace_recorder&) {}
+        trace_recorder& operator=(trace_recorder&& other) noexcept {
+            trace_recorder tmp{std::move(other)};
+            swap(tmp);
+            return *this;
+        }
+        trace_recorder& operator=(const trace_recorder&) {
+            return *this;
+        }
+        /* without the computer at hand the IP is taken to be right after the last instruction */
+        ~trace_recorder() {
+            close(next_);
+        }
+
+        template <typename T>
+        void open(const std::string& path, const std::vector<T>& memory, T ip, T relbase) {
+            if (!file_.create(path, std::max<size_t>(initial_size, memory.size() * 10 + 64))) {
+                fmt::print(::stderr, "CANNOT CREATE TRACE {}: {}\n", path, std::strerror(errno));
+                std::abort();
+            }
+            out_ = std::copy(std::begin(magic), std::end(magic), file_.data());
+            out_ = detail::put_varint(out_, version);
+            out_ = detail::put_varint(out_, memory.size());
+            for (auto v : memory)
+                out_ = detail::put_varint(out_, detail::zigzag(int64_t(v)));
+            out_ = detail::put_varint(out_, detail::zigzag(int64_t(ip)));
+            out_ = detail::put_varint(out_, detail::zigzag(int64_t(relbase)));
+            step_ = out_;
+            next_ = int64_t(ip);
+            address_ = 0;
+        }
+        void close(int64_t ip) {
+            if (!out_)
+                return;
+            event(EK_END, detail::zigzag(ip - next_));
+            file_.close(size_t(out_ - file_.data()));
+            out_ = nullptr;
+        }
+
+        inline bool recording() const {
+            return out_ != nullptr;
+        }
+
+        inline void step(int64_t ip, uint8_t length) {
+            if (!out_)
+                return;
+            reserve();
+            step_ = out_;
+            step_next_ = next_;
+            out_ = detail::put_varint(out_, detail::zigzag(ip - next_) << 1 | 1);
+            next_ = ip + length;
+        }
+        /* forgets the last step, for an instruction which gave up without doing anything */
+        inline void unstep() {
+            if (!out_)
+                return;
+            out_ = step_;
+            next_ = step_next_;
+        }
+        inline void write(int64_t address, int64_t value) {
+            if (!out_)
+                return;
+            reserve();
+            out_ = detail::put_varint(out_, uint64_t(EK_WRITE) << 1);
+            out_ = detail::put_varint(out_, detail::zigzag(address - address_));
+            out_ = detail::put_varint(out_, detail::zigzag(value));
+            address_ = address;
+        }
+        inline void relbase(int64_t delta) {
+            event(EK_RELBASE, detail::zigzag(delta));
+        }
+        inline void input(int64_t value) {
+            event(EK_INPUT, detail::zigzag(value));
+        }
+        inline void output(int64_t value) {
+            event(EK_OUTPUT, detail::zigzag(value));
+        }
+
+    private:
+        static constexpr const size_t initial_size = size_t(1) << 20;
+        /* the most one step or event can take */
+        static constexpr const size_t max_record = 32;
+
+        inline void reserve() {
+            if (size_t(file_.data() + file_.size() - out_) >= max_record) [[likely]]
+                return;
+            auto used = size_t(out_ - file_.data());
+            auto step = size_t(step_ - file_.data());
+            if (!file_.resize(file_.size() * 2)) {
+                fmt::print(::stderr, "CANNOT GROW TRACE: {}\n", std::strerror(errno));
+                std::abort();
+            }
+            out_ = file_.data() + used;
+            step_ = file_.data() + step;
+        }
+        inline void event(event_kind kind, uint64_t operand) {
+            if (!out_)
+                return;
+            reserve();
+            out_ = detail::put_varint(out_, uint64_t(kind) << 1);
+            out_ = detail::put_varint(out_, operand);
+        }
+        void swap(trace_recorder& other) {
+            std::swap(file_, other.file_);
+            std::swap(out_, other.out_);
+            std::swap(step_, other.step_);
+            std::swap(next_, other.next_);
+            std::swap(step_next_, other.step_next_);
+            std::swap(address_, other.address_);
+        }
+
+        detail::mapped_file file_{};
+        uint8_t* out_{nullptr};
+        uint8_t* step_{nullptr};
+        int64_t next_{0};
+        int64_t step_next_{0};
+        int64_t address_{0};
+    };
+
+    /*
+     * How often each superinstruction ran. A pair is only run fused while the decode cache still holds
+     * the instruction it was fused with; when that was overwritten the first half runs alone and the
+     * second is dispatched normally, which is counted as a miss.
+     */
+    class fusion_counters {
+    public:
+        enum superinstruction : uint8_t {
+            SI_LT_JNZ,
+            SI_LT_JZ,
+            SI_EQ_JNZ,
+            SI_EQ_JZ,
+            SI_ADD_JNZ,
+            SI_ADD_JZ,
+            SI_SRB_JNZ,
+            SI_SRB_JZ,
+            SI_COUNTER,
+            SI_MAX_,
+        };
+
+        inline void fired(superinstruction si) {
+            fired_[si] += 1;
+        }
+        inline void missed(superinstruction si) {
+            missed_[si] += 1;
+        }
+        inline uint64_t fired(size_t si) const {
+            return si < SI_MAX_ ? fired_[si] : 0;
+        }
+        inline uint64_t missed(size_t si) const {
+            return si < SI_MAX_ ? missed_[si] : 0;
+        }
+        void clear() {
+            fired_.fill(0);
+            missed_.fill(0);
+        }
+
+        void report(std::FILE* out = stderr) const {
+            uint64_t total{0};
+            for (auto count : fired_)
+                total += count;
+            fmt::print(out, "superinstruction       fired      %     missed\n");
+            for (size_t si = 0; si < SI_MAX_; si++) {
+                fmt::print(out, "{:<16} {:>11} {:>6.2f} {:>10}\n", names[si], fired_[si],
+                           total ? 100.0 * double(fired_[si]) / double(total) : 0.0, missed_[si]);
             }
+        }
 
-        private:
-            cb_t callbacks_[max_entries]{};
+        static constexpr const char* names[SI_MAX_] = {
+            "LT+JNZ", "LT+JZ", "EQ+JNZ", "EQ+JZ", "ADD+JNZ", "ADD+JZ", "SRB+JNZ", "SRB+JZ", "ADD x,imm,x",
         };
-    }
 
-    class computer {
+    private:
+        std::array<uint64_t, SI_MAX_> fired_{};
+        std::array<uint64_t, SI_MAX_> missed_{};
+    };
+
+    /*
+     * Compile-time knobs of basic_computer. A checked policy validates every register and memory access.
+     * An unchecked one maps `memory_size` words up front and trusts the program to stay inside them, so
+     * loads, stores and decode cache lookups skip their range checks. A tracing policy has trace() called
+     * with the computer in front of every instruction, a profiling one keeps an execution_profile, a
+     * sampling one an execution_sampler, a recording one a trace_recorder and a checkpointing one counts
+     * instructions and keeps the checkpoints rewind_to() goes back to. A counting one keeps
+     * fusion_counters; the other hooks see every instruction, so they turn superinstructions off.
+     */
+    struct checked_policy {
+        static constexpr const bool checked = true;
+        static constexpr const bool tracing = false;
+        static constexpr const bool profiling = false;
+        static constexpr const bool sampling = false;
+        static constexpr const bool recording = false;
+        static constexpr const bool checkpointing = false;
+        static constexpr const bool counting = false;
+        static constexpr const size_t memory_size = 0;
+    };
+
+    template <size_t words = size_t(1) << 14>
+    struct unchecked_policy {
+        static constexpr const bool checked = false;
+        static constexpr const bool tracing = false;
+        static constexpr const bool profiling = false;
+        static constexpr const bool sampling = false;
+        static constexpr const bool recording = false;
+        static constexpr const bool checkpointing = false;
+        static constexpr const bool counting = false;
+        static constexpr const size_t memory_size = words;
+    };
+
+    struct tracing_policy : checked_policy {
+        static constexpr const bool tracing = true;
+
+        template <typename C>
+        static inline void trace(const C& c) {
+            auto ip = c.instruction_pointer();
+            const auto& m = c.memory();
+            fmt::print(::stderr, "{:>6}: {:>6} {} {} {}\n", ip, m.read(ip), m.read(ip + 1), m.read(ip + 2), m.read(ip + 3));
+        }
+    };
+
+    struct profiling_policy : checked_policy {
+        static constexpr const bool profiling = true;
+    };
+
+    struct sampling_policy : checked_policy {
+        static constexpr const bool sampling = true;
+    };
+
+    struct recording_policy : checked_policy {
+        static constexpr const bool recording = true;
+    };
+
+    struct checkpointing_policy : checked_policy {
+        static constexpr const bool checkpointing = true;
+    };
+
+    struct counting_policy : checked_policy {
+        static constexpr const bool counting = true;
+    };
+
+    template <typename policy>
+    class basic_computer {
     public:
         using memory_value_t = int64_t;
+        using memory_t = detail::paged_memory<memory_value_t>;
 
         enum instruction_code : memory_value_t {
             OP_ADD = 1,
@@ -74,18 +1325,69 @@ namespace aoc {
             AM_RELBASE = 2,
             AM_MAX_,
         };
+        static_assert(execution_profile::max_opcode == OP_INVAL + 1 && execution_profile::mode_combinations == AM_MAX_ * AM_MAX_ * AM_MAX_);
+
+        /* why execute_until_blocked() returned */
+        enum block_reason {
+            BR_HALTED,
+            BR_NEEDS_INPUT,
+            BR_OUTPUT,
+        };
+
+        /*
+         * Optional back end (see computer_jit.h and computer_ir.h). It is offered control at the start of a
+         * run and after every jump, IN and OUT and returns once it reaches something it does not handle. Writes
+         * made by the interpreter or through mem_ref() are reported to invalidate(). A copied computer
+         * gets a clone() of its source's accelerator which is not expected to carry translations over.
+         */
+        class accelerator {
+        public:
+            virtual ~accelerator() = default;
+
+            virtual std::unique_ptr<accelerator> clone() const = 0;
+            virtual bool handles(instruction_code code) const = 0;
+            virtual void run(basic_computer& c) = 0;
+            virtual void invalidate(size_t address, size_t count) = 0;
+            virtual void flush() = 0;
+
+        protected:
+            static inline memory_t& memory_of(basic_computer& c) {
+                return c.memory_;
+            }
+            static inline memory_value_t& register_ref(basic_computer& c, register_code reg) {
+                return c.registers_.at(reg);
+            }
+            /* must be called after writing to memory behind the interpreter's back */
+            static inline void drop_decoded(basic_computer& c, size_t address) {
+                c.invalidate_decoded(address);
+            }
+            static inline void drop_decoded(basic_computer& c, size_t address, size_t count) {
+                c.invalidate_decoded(address, count);
+            }
+        };
+
+        basic_computer() {
+            map();
+        }
+        basic_computer(basic_computer&&) = default;
+        basic_computer(const basic_computer& other) = default;
 
-        computer() = default;
-        computer(computer&&) = default;
-        computer(const computer& other) = default;
+        basic_computer& operator=(const basic_computer& other) = default;
+        basic_computer& operator=(basic_computer&& other) = default;
 
-        computer& operator=(const computer& other) = default;
-        computer& operator=(computer&& other) = default;
+        /*
+         * Copies share the memory image with their source and only duplicate the pages either side
+         * writes afterwards, so a fork costs about as much as the registers and queues. This is the
+         * same as a plain copy, it just says so at the call site. Forking revokes the source's write
+         * access to its pages, so one computer must not be forked from several threads at once.
+         */
+        inline basic_computer fork() const {
+            return basic_computer(*this);
+        }
 
-        static inline computer read_initial_state(std::istream& in = std::cin) {
-            computer ret{};
+        static inline basic_computer read_initial_state(std::istream& in = std::cin) {
+            basic_computer ret{};
             std::string buff;
-            std::vector<memory_value_t> memory;
             while (std::getline(in, buff)) {
                 if (!ret.add_memory_values(buff))
                     break;
@@ -96,6 +1398,13 @@ namespace aoc {
         const auto& memory() const {
             return memory_;
         }
+
+        void set_accelerator(std::unique_ptr<accelerator> accel) {
+            accel_ = std::move(accel);
+        }
+        accelerator* get_accelerator() const {
+            return accel_.get();
+        }
         bool add_memory_value(std::string_view buff) {
             memory_value_t v{};
             std::string_view sv = aoc::trim(buff);
@@ -114,69 +1423,278 @@ namespace aoc {
             }
             return true;
         }
+        /* memory is allocated on first touch, this is only needed for a non-zero fill value */
         void expand_memory(size_t size, memory_value_t initial_value = 0) {
-            if (size > memory_.size()) {
-                memory_.reserve(size);
-                while (memory_.size() < memory_.capacity())
+            if (initial_value) {
+                while (memory_.size() < size)
                     memory_.push_back(initial_value);
             }
+            memory_.reserve(size);
         }
 
         inline void single_step() {
-            auto raw = memory_.at(size_t(ip()));
-            auto code = raw % 100;
-            auto mode = raw / 100;
-            instruction_callbacks[int(code)](*this, mode);
+            const auto& d = fetch();
+            d.handler(*this, d);
+            if constexpr (policy::profiling)
+                profile_.stop();
+        }
+
+        const execution_profile& profile() const requires policy::profiling {
+            return profile_;
+        }
+        void clear_profile() requires policy::profiling {
+            profile_.clear();
+        }
+        execution_sampler& sampler() requires policy::sampling {
+            return sampler_;
+        }
+        const execution_sampler& sampler() const requires policy::sampling {
+            return sampler_;
+        }
+        const fusion_counters& fusions() const requires policy::counting {
+            return fusions_;
+        }
+        void clear_fusions() requires policy::counting {
+            fusions_.clear();
+        }
+        /* records everything the interpreter does from here on to `path` (see trace_recorder) */
+        void start_trace(const std::string& path) requires policy::recording {
+            trace_.close(ip());
+            trace_.open(path, memory_.to_vector(), ip(), reg_ref<RC_RELBASE>());
+        }
+        void stop_trace() requires policy::recording {
+            trace_.close(ip());
+        }
+
+        /*
+         * A checkpoint (registers and a copy-on-write copy of memory, so only pages written afterwards
+         * cost anything) is taken in front of instruction 0, every `every` instructions
+         * (0 for never) and, with `at_inputs`, in front of every IN. Beyond `budget` checkpoints every
+         * other one is dropped, except for the first and the latest, so older history gets sparser but
+         * stays reachable. Every input consumed is logged with the instruction that took it.
+         *
+         * Rewinding goes back to the closest earlier checkpoint and single-steps to the target, feeding
+         * IN from the log and dropping what OUT produces, since the host has already seen it. Outputs made
+         * after the target which are still queued are dropped. Writes made through mem_ref() and
+         * instructions run by an accelerator are not seen, so rewinding across them does not reproduce them.
+         */
+        void set_checkpoints(uint64_t every, bool at_inputs = true, size_t budget = 64) requires policy::checkpointing {
+            rewind_.every = every;
+            rewind_.at_inputs = at_inputs;
+            rewind_.budget = std::max<size_t>(2, budget);
+            /* the first checkpoint is always taken, it is what a rewind falls back to */
+            if (rewind_.checkpoints.empty())
+                rewind_.next = rewind_.instructions;
+            else
+                rewind_.next = every ? rewind_.instructions + every : std::numeric_limits<uint64_t>::max();
+        }
+        inline uint64_t instruction_count() const requires policy::checkpointing {
+            return rewind_.instructions;
+        }
+        inline size_t checkpoint_count() const requires policy::checkpointing {
+            return rewind_.checkpoints.size();
+        }
+        inline size_t consumed_inputs() const requires policy::checkpointing {
+            return rewind_.inputs.size();
+        }
+        /* back to right before instruction `count`; the inputs consumed after it go back in front of the queue */
+        void rewind_to(uint64_t count) requires policy::checkpointing {
+            rewind(count, true);
+        }
+        /* back to right before the IN which consumed the `count`-th last input, forgetting the last `count` inputs */
+        void rewind_inputs(size_t count) requires policy::checkpointing {
+            if (count > rewind_.inputs.size()) {
+                fmt::print(::stderr, "CANNOT REWIND {} INPUTS, ONLY {} CONSUMED\n", count, rewind_.inputs.size());
+                std::abort();
+            }
+            if (count)
+                rewind(rewind_.inputs[rewind_.inputs.size() - count].instruction, false);
         }
 
         void execute() {
             clear_flags(CF_HALTED);
-            while (!has_flags(CF_HALTED))
-                single_step();
+            run([](instruction_code) { return false; }, accel_.get());
         }
 
         void execute_with_pause(const std::set<instruction_code>& after) {
-            clear_flags(CF_HALTED | CF_PAUSED);
-            while (!has_flags(CF_HALTED)) {
-                auto raw = memory_.at(size_t(ip()));
-                auto code = raw % 100;
-                auto mode = raw / 100;
-                instruction_callbacks[int(code)](*this, mode);
-                if (after.count(instruction_code(code))) {
-                    set_flags(CF_PAUSED);
-                    return;
-                }
+            std::bitset<OP_INVAL + 1> pause_on{};
+            auto accel = accel_.get();
+            for (auto code : after) {
+                pause_on.set(size_t(code));
+                if (accel && accel->handles(code))
+                    accel = nullptr;
             }
+            clear_flags(CF_HALTED | CF_PAUSED);
+            run([&pause_on](instruction_code code) { return pause_on.test(size_t(code)); }, accel);
+        }
+
+        /*
+         * Runs at full speed until the program halts, has produced `output_count` outputs (0 for no
+         * limit) or needs input. Without a default input it stops in front of an IN with nothing queued;
+         * with one it stops right after an IN which had to use it, so polling programs hand control back.
+         */
+        block_reason execute_until_blocked(size_t output_count = 1) {
+            size_t outputs{0};
+            clear_flags(CF_HALTED | CF_PAUSED | CF_NEEDS_INPUT);
+            set_flags(CF_UNTIL_BLOCKED);
+            run([this, &outputs, output_count](instruction_code code) {
+                if (code == OP_IN)
+                    return has_flags(CF_NEEDS_INPUT);
+                if (code == OP_OUT)
+                    return output_count && ++outputs >= output_count;
+                return false;
+            }, accel_.get());
+            clear_flags(CF_UNTIL_BLOCKED);
+            if (has_flags(CF_NEEDS_INPUT))
+                return BR_NEEDS_INPUT;
+            return is_halted() ? BR_HALTED : BR_OUTPUT;
         }
 
         template <size_t N>
-        void execute_with_conditional_breakpoints(const std::function<bool(const computer&)>(&breakpoints)[N]) {
+        void execute_with_conditional_breakpoints(const std::function<bool(const basic_computer&)>(&breakpoints)[N]) {
             clear_flags(CF_HALTED | CF_PAUSED);
-            while (!has_flags(CF_HALTED)) {
-                single_step();
+            run([this, &breakpoints](instruction_code) {
                 for (const auto& breakpoint : breakpoints) {
-                    if (breakpoint(*this)) {
-                        set_flags(CF_PAUSED);
-                        return;
-                    }
+                    if (breakpoint(*this))
+                        return true;
                 }
-            }
+                return false;
+            }, nullptr);
         }
 
         inline void reset(size_t memory_clear_offset = size_t(-1), size_t memory_clear_size = 0) {
+            if constexpr (policy::checkpointing)
+                rewind_.clear();
             registers_.fill(0);
             inputs_.clear();
             outputs_.clear();
             flags_ = 0;
-            if (memory_clear_offset < memory_.size() && memory_clear_size > 0)
-                std::fill(memory_.data() + memory_clear_offset,
-                          memory_.data() + memory_clear_offset + std::min(memory_.size() - memory_clear_offset, memory_clear_size),
-                          0);
+            halted_.store(false);
+            if (memory_clear_offset < memory_.size() && memory_clear_size > 0) {
+                auto count = std::min(memory_.size() - memory_clear_offset, memory_clear_size);
+                memory_.fill_zero(memory_clear_offset, count);
+                invalidate_decoded(memory_clear_offset, count);
+                if (accel_)
+                    accel_->invalidate(memory_clear_offset, count);
+            }
         }
 
         inline void clear() {
             reset();
             memory_.clear();
+            decoded_.clear();
+            map();
+            if (accel_)
+                accel_->flush();
+        }
+
+        /* marks the current memory as what reset_to_baseline() goes back to */
+        inline void set_baseline() {
+            memory_.set_baseline();
+        }
+        /* reset() plus undoing every memory write since set_baseline(), at the cost of the pages written */
+        void reset_to_baseline() {
+            if (!memory_.has_baseline()) {
+                fmt::print(::stderr, "NO BASELINE TO RESET TO\n");
+                std::abort();
+            }
+            reset();
+            memory_.restore_baseline([this](size_t address) {
+                invalidate_decoded(address);
+                if (accel_)
+                    accel_->invalidate(address, 1);
+            });
+        }
+
+        /*
+         * Writes the registers, flags, I/O queues and every allocated memory page below size() to `path`
+         * (reset_to_baseline() keeps the ones past it around, zeroed, for the next run). Pages go at
+         * the end, each in one aligned 4 KiB block, so load_snapshot() can use them straight from a
+         * mapping of the file; restoring costs a page table entry per page and the pages only get
+         * copied once written to. Both return false on I/O errors; loading also fails on a snapshot of
+         * another version or one whose header does not match its contents and leaves the computer cleared.
+         */
+        bool save_snapshot(const std::string& path) const {
+            auto page_count = (memory_.size() + memory_t::page_size - 1) / memory_t::page_size;
+            std::vector<uint64_t> index{};
+            memory_.for_each_page([&index, page_count](size_t page, const memory_value_t*) {
+                if (page < page_count)
+                    index.push_back(page);
+            });
+
+            snapshot_header h{};
+            std::copy(std::begin(snapshot_magic), std::end(snapshot_magic), h.magic);
+            h.version = snapshot_version;
+            h.page_words = memory_t::page_size;
+            std::copy(registers_.begin(), registers_.end(), h.registers);
+            h.flags = flags_;
+            h.memory_size = memory_.size();
+            h.inputs = inputs_.size();
+            h.outputs = outputs_.size();
+            h.pages = index.size();
+            auto queues = sizeof(h) + (h.inputs + h.outputs + h.pages) * sizeof(uint64_t);
+            h.data_offset = (queues + snapshot_alignment - 1) & ~(snapshot_alignment - 1);
+
+            detail::mapped_file file{};
+            if (!file.create(path, h.data_offset + index.size() * memory_t::page_size * sizeof(memory_value_t)))
+                return false;
+            auto* out = file.data();
+            out = std::copy_n(reinterpret_cast<const uint8_t*>(&h), sizeof(h), out);
+            auto put = [&out](uint64_t v) { std::memcpy(out, &v, sizeof(v)); out += sizeof(v); };
+            std::for_each(inputs_.begin(), inputs_.end(), put);
+            std::for_each(outputs_.begin(), outputs_.end(), put);
+            std::for_each(index.begin(), index.end(), put);
+            out = file.data() + h.data_offset;
+            memory_.for_each_page([&out, page_count](size_t page, const memory_value_t* words) {
+                if (page < page_count)
+                    out = std::copy_n(reinterpret_cast<const uint8_t*>(words), memory_t::page_size * sizeof(memory_value_t), out);
+            });
+            return true;
+        }
+        bool load_snapshot(const std::string& path) {
+            clear();
+            auto file = std::make_shared<detail::mapped_file>();
+            if (!file->open(path, true) || file->size() < sizeof(snapshot_header))
+                return false;
+            snapshot_header h{};
+            std::memcpy(&h, file->data(), sizeof(h));
+            if (!std::equal(std::begin(snapshot_magic), std::end(snapshot_magic), h.magic) ||
+                h.version != snapshot_version || h.page_words != memory_t::page_size)
+                return false;
+
+            /* every count is checked against the file before anything is multiplied by it */
+            constexpr auto page_bytes = memory_t::page_size * sizeof(memory_value_t);
+            auto words = file->size() / sizeof(uint64_t);
+            if (h.inputs > words || h.outputs > words || h.pages > words ||
+                h.data_offset < sizeof(h) + (h.inputs + h.outputs + h.pages) * sizeof(uint64_t) ||
+                h.data_offset > file->size() || h.data_offset % alignof(memory_value_t) ||
+                h.pages > (file->size() - h.data_offset) / page_bytes || h.memory_size > uint64_t(memory_t::max_address))
+                return false;
+
+            const auto* in = file->data() + sizeof(h);
+            auto get = [&in] { uint64_t v{}; std::memcpy(&v, in, sizeof(v)); in += sizeof(v); return v; };
+            std::vector<uint64_t> index(h.pages);
+            in += (h.inputs + h.outputs) * sizeof(uint64_t);
+            /* save_snapshot() writes each page once, in order, and none past memory_size */
+            auto page_count = (h.memory_size + memory_t::page_size - 1) / memory_t::page_size;
+            for (size_t idx = 0; idx < index.size(); idx++) {
+                index[idx] = get();
+                if (index[idx] >= page_count || (idx && index[idx] <= index[idx - 1]))
+                    return false;
+            }
+
+            in = file->data() + sizeof(h);
+            std::copy(std::begin(h.registers), std::end(h.registers), registers_.begin());
+            flags_ = h.flags;
+            halted_.store(has_flags(CF_HALTED));
+            for (uint64_t idx = 0; idx < h.inputs; idx++)
+                inputs_.push_back(memory_value_t(get()));
+            for (uint64_t idx = 0; idx < h.outputs; idx++)
+                outputs_.push_back(memory_value_t(get()));
+            auto* data = reinterpret_cast<memory_value_t*>(file->data() + h.data_offset);
+            memory_.adopt(file, index.data(), data, index.size(), size_t(h.memory_size));
+            map();
+            return true;
         }
 
         const auto& inputs() const {
@@ -213,9 +1731,27 @@ namespace aoc {
             outputs_.clear();
         }
         auto get_output() {
-            auto ret = std::optional<memory_value_t>(outputs_.size() ? outputs_.front() : std::optional<memory_value_t>());
-            if (outputs_.size()) outputs_.pop_front();
-            return ret;
+            return outputs_.try_pop();
+        }
+
+        /*
+         * With blocking I/O the computer and one other thread can share its queues: IN waits for
+         * input (unless a default is set) and OUT waits while the outputs are full instead of growing
+         * them. The other thread only uses push_input(), get_output() and is_halted().
+         */
+        void set_blocking_io(bool enabled, size_t capacity = detail::ring_buffer<memory_value_t>::default_capacity) {
+            if (enabled) {
+                set_flags(CF_BLOCKING_IO);
+                inputs_.reserve(capacity);
+                outputs_.reserve(capacity);
+            } else {
+                clear_flags(CF_BLOCKING_IO);
+            }
+        }
+        /* producer side of the inputs, returns false if they are full */
+        template <typename T, typename = typename std::enable_if<std::is_integral<T>::value>::type>
+        bool push_input(T v) {
+            return inputs_.try_push(memory_value_t(v));
         }
 
         auto flags() const {
@@ -223,150 +1759,781 @@ namespace aoc {
         }
         void set_flags(memory_value_t flags) {
             flags_ |= flags;
+            if (flags & CF_HALTED)
+                halted_.store(true);
         }
         void clear_flags(memory_value_t flags) {
             flags_ &= ~flags;
+            if (flags & CF_HALTED)
+                halted_.store(false);
         }
         bool has_flags(memory_value_t flags) const {
             return (flags_ & flags) == flags;
         }
 
+        /* safe to call from the other side of blocking I/O while the computer runs */
         bool is_halted() const {
-            return has_flags(CF_HALTED);
+            return halted_.load();
         }
         bool is_paused() const {
             return has_flags(CF_PAUSED);
         }
+        memory_value_t instruction_pointer() const {
+            return registers_[RC_IP];
+        }
+        memory_value_t relative_base() const {
+            return registers_[RC_RELBASE];
+        }
+        void set_instruction_pointer(memory_value_t v) {
+            reg_ref<RC_IP>() = v;
+        }
+        void set_relative_base(memory_value_t v) {
+            reg_ref<RC_RELBASE>() = v;
+        }
 
         void set_default_input(memory_value_t val) {
             set_flags(CF_DEFAULT_INPUT);
             reg_ref<RC_DEFAULT_INPUT>() = val;
         }
 
+        /* the returned reference may be written through so any decoded instruction at that address is dropped */
         inline memory_value_t& mem_ref(memory_value_t address, addressing_mode mode = AM_POSITION) {
-            switch (mode) {
-                case AM_POSITION: return memory_.at(size_t(memory_.at(size_t(address))));
-                case AM_IMMEDIATE: return memory_.at(size_t(address));
-                case AM_RELBASE: return memory_.at(size_t(memory_.at(size_t(address)) + reg_ref<RC_RELBASE>()));
-                default: std::abort();
-            }
+            auto addr = resolve(address, mode);
+            auto& ret = memory_.ref(addr);
+            invalidate_decoded(size_t(addr));
+            if (accel_)
+                accel_->invalidate(size_t(addr), 1);
+            return ret;
         }
 
     private:
+        struct decoded_instruction_t;
+
+        using instruction_callback_t = void (*)(basic_computer&, const decoded_instruction_t&);
+
+        /* index into the threaded dispatch table, kept dense so HLT and invalid opcodes fit */
+        enum dispatch_slot : uint8_t {
+            DS_INVAL,
+            DS_ADD, DS_MUL, DS_IN, DS_OUT, DS_JNZ, DS_JZ, DS_LT, DS_EQ, DS_SRB,
+            DS_HLT,
+            /* superinstructions, in fusion_counters::superinstruction order */
+            DS_LT_JNZ, DS_LT_JZ, DS_EQ_JNZ, DS_EQ_JZ, DS_ADD_JNZ, DS_ADD_JZ, DS_SRB_JNZ, DS_SRB_JZ,
+            DS_COUNTER,
+            DS_MAX_,
+        };
+
+        /* instruction hooks have to see every instruction, which a superinstruction would skip */
+        static constexpr const bool fuses = AOC_COMPUTER_FUSION && AOC_COMPUTER_THREADED_DISPATCH && !policy::tracing &&
+                                            !policy::profiling && !policy::sampling && !policy::recording && !policy::checkpointing;
+
         struct decoded_instruction_t {
-            instruction_code code{OP_INVAL};
-            memory_value_t modes{0};
+            instruction_callback_t handler{nullptr};
+            uint8_t code{0};
+            uint8_t slot{DS_INVAL};
+            uint8_t length{0};
+            std::array<uint8_t, 3> modes{};
+            /* for DS_COUNTER, the input parameter which names the same cell as the output */
+            uint8_t cell{0};
+
+            inline addressing_mode mode(size_t param) const {
+                return addressing_mode(modes[param]);
+            }
         };
 
         template <register_code reg>
         inline memory_value_t& reg_ref() {
-            return registers_.at(reg);
+            if constexpr (policy::checked)
+                return registers_.at(reg);
+            else
+                return registers_[reg];
+        }
+
+        inline void map() {
+            if constexpr (!policy::checked) {
+                memory_.map(policy::memory_size);
+                decoded_.resize(policy::memory_size);
+            }
+        }
+        inline memory_value_t read(memory_value_t address) const {
+            if constexpr (policy::checked)
+                return memory_.read(address);
+            else
+                return memory_.read_unchecked(address);
         }
 
         inline memory_value_t& ip() {
             return reg_ref<RC_IP>();
         }
 
-        template <memory_value_t param, memory_value_t max_params>
-        static inline addressing_mode mode_for(memory_value_t modes) {
-            constexpr const auto actual_param = std::clamp<memory_value_t>(param, 1, max_params);
-            constexpr const auto div = cpow<memory_value_t>(10, actual_param - 1);
-            return addressing_mode((modes / div) % 10);
+        inline memory_value_t resolve(memory_value_t address, addressing_mode mode) {
+            switch (mode) {
+                case AM_POSITION: return read(address);
+                case AM_IMMEDIATE: return address;
+                case AM_RELBASE: return read(address) + reg_ref<RC_RELBASE>();
+                default: std::abort();
+            }
+        }
+        inline memory_value_t load(memory_value_t address, addressing_mode mode) {
+            auto addr = resolve(address, mode);
+            if constexpr (policy::profiling)
+                profile_.read(size_t(addr));
+            return read(addr);
+        }
+        inline void store(memory_value_t address, addressing_mode mode, memory_value_t value) {
+            store_at(resolve(address, mode), value);
+        }
+        inline void store_at(memory_value_t addr, memory_value_t value) {
+            if constexpr (policy::profiling)
+                profile_.write(size_t(addr));
+            if constexpr (policy::recording)
+                trace_.write(addr, value);
+            if constexpr (policy::checked)
+                memory_.write(addr, value);
+            else
+                memory_.ref_unchecked(addr) = value;
+            invalidate_decoded(size_t(addr));
+            if (accel_)
+                accel_->invalidate(size_t(addr), 1);
+        }
+
+        /*
+         * Only the opcode word is folded into a decoded instruction (operands are still read every time
+         * it runs) so a write has to drop at most the one entry at the address it hit.
+         */
+        inline void invalidate_decoded(size_t address) {
+            if (!policy::checked || address < decoded_.size())
+                decoded_[address].handler = nullptr;
+        }
+        inline void invalidate_decoded(size_t address, size_t count) {
+            auto last = std::min(decoded_.size(), address + count);
+            for (auto addr = address; addr < last; addr++)
+                decoded_[addr].handler = nullptr;
+        }
+
+        inline const decoded_instruction_t& fetch() {
+            if constexpr (policy::tracing)
+                policy::trace(*this);
+            auto addr = size_t(ip());
+            const auto& ret = (!policy::checked || addr < decoded_.size()) && decoded_[addr].handler ? decoded_[addr] : decode_and_fuse(ip());
+            if constexpr (policy::profiling)
+                profile_.instruction(addr, ret.code, ret.length, ret.modes);
+            if constexpr (policy::sampling)
+                sampler_.instruction(addr, ret.code, ret.length, reg_ref<RC_RELBASE>());
+            if constexpr (policy::recording)
+                trace_.step(int64_t(addr), ret.length);
+            if constexpr (policy::checkpointing) {
+                if (rewind_.instructions >= rewind_.next || (ret.code == OP_IN && rewind_.at_inputs)) [[unlikely]]
+                    checkpoint();
+                rewind_.instructions += 1;
+            }
+            return ret;
+        }
+
+        const decoded_instruction_t& decode_and_fuse(memory_value_t address) {
+            /* nothing was ever loaded or written there, so it reads as opcode 0; no need to grow the cache to say so */
+            if constexpr (policy::checked) {
+                if (size_t(address) >= memory_.size()) [[unlikely]]
+                    return invalid_instruction;
+            }
+            if constexpr (fuses)
+                fuse(size_t(address));
+            else
+                decode(address);
+            return decoded_[size_t(address)];
+        }
+
+        const decoded_instruction_t& decode(memory_value_t address) {
+            auto raw = memory_.read(address);
+            auto code = raw % 100;
+            auto modes = raw / 100;
+
+            if (decoded_.size() <= size_t(address))
+                decoded_.resize(size_t(address) + 1);
+
+            auto& ret = decoded_[size_t(address)];
+            if (code > 0 && code < OP_INVAL && instruction_lengths[int(code)]) {
+                ret.handler = instruction_callbacks[int(code)];
+                ret.code = uint8_t(code);
+                ret.slot = code == OP_HLT ? DS_HLT : dispatch_slot(code);
+                ret.length = uint8_t(instruction_lengths[int(code)]);
+            } else {
+                ret.handler = &basic_computer::icb_invalid_instruction;
+                ret.code = uint8_t(OP_INVAL);
+                ret.slot = DS_INVAL;
+                ret.length = 1;
+            }
+            for (auto& mode : ret.modes) {
+                mode = uint8_t(std::clamp<memory_value_t>(modes % 10, 0, AM_MAX_));
+                modes /= 10;
+            }
+            return ret;
+        }
+
+        /*
+         * Decodes the instruction at `address` and, if it starts one of the idioms compilers emit, gives it
+         * a superinstruction slot: LT/EQ followed by a jump on the result, ADD (pushing a return address)
+         * or SRB (dropping a frame) followed by a jump, and ADD x,imm,x counters. Only the slot changes, so
+         * single_step() and the other dispatch loop still run one plain handler per instruction.
+         */
+        void fuse(size_t address) {
+            decode(memory_value_t(address));
+            auto first = decoded_[address];
+            auto next = address + first.length;
+            /* the longest idiom spans six words: LT/EQ and the opcode and condition of the jump */
+            std::array<memory_value_t, 6> words{};
+            for (size_t idx = 0; idx < words.size(); idx++)
+                words[idx] = memory_.read(memory_value_t(address + idx));
+            /* only a jump gets decoded ahead, since jumps never start a superinstruction themselves */
+            auto jumps_after = [this, next, &words, &first] {
+                auto code = words[first.length] % 100;
+                if (code != OP_JNZ && code != OP_JZ)
+                    return 0;
+                if (next >= decoded_.size() || !decoded_[next].handler)
+                    decode(memory_value_t(next));
+                return code == OP_JNZ ? 1 : 2;
+            };
+            uint8_t slot{first.slot};
+            switch (first.code) {
+                case OP_LT: [[fallthrough]];
+                case OP_EQ: {
+                    if (auto jump = jumps_after()) {
+                        if (decoded_[next].modes[0] == first.modes[2] && words[5] == words[3])
+                            slot = uint8_t((first.code == OP_LT ? DS_LT_JNZ : DS_EQ_JNZ) + jump - 1);
+                    }
+                    break;
+                }
+                case OP_ADD: {
+                    if (auto jump = jumps_after()) {
+                        slot = uint8_t(DS_ADD_JNZ + jump - 1);
+                        break;
+                    }
+                    for (uint8_t p = 0; p < 2; p++) {
+                        if (first.modes[p] == first.modes[2] && first.modes[2] != AM_IMMEDIATE && first.modes[1 - p] == AM_IMMEDIATE &&
+                            words[1 + p] == words[3]) {
+                            slot = DS_COUNTER;
+                            decoded_[address].cell = p;
+                            break;
+                        }
+                    }
+                    break;
+                }
+                case OP_SRB: {
+                    if (auto jump = jumps_after())
+                        slot = uint8_t(DS_SRB_JNZ + jump - 1);
+                    break;
+                }
+                default: break;
+            }
+            decoded_[address].slot = slot;
+        }
+
+        /*
+         * Runs until the program halts or `pause` (called with the code of every instruction right
+         * after it executes) returns true, in which case CF_PAUSED is set. `accel` (if any) must not
+         * handle any instruction `pause` can stop on.
+         */
+        template <typename pause_check_t>
+        inline void run(const pause_check_t& pause, accelerator* accel) {
+            /* the clock of the last instruction must not keep running while the host has control */
+            struct profile_stop {
+                basic_computer& c;
+                ~profile_stop() {
+                    if constexpr (policy::profiling)
+                        c.profile_.stop();
+                }
+            } stop_profile{*this};
+#if AOC_COMPUTER_THREADED_DISPATCH
+            static void* const dispatch_table[] = {
+                &&op_inval, &&op_add, &&op_mul, &&op_in, &&op_out,
+                &&op_jnz, &&op_jz, &&op_lt, &&op_eq, &&op_srb, &&op_hlt,
+                &&op_lt_jump, &&op_lt_jump, &&op_eq_jump, &&op_eq_jump, &&op_add_jump, &&op_add_jump,
+                &&op_srb_jump, &&op_srb_jump, &&op_counter,
+            };
+            static_assert(std::size(dispatch_table) == DS_MAX_);
+            const decoded_instruction_t* d{nullptr};
+            /* the slot of the superinstruction whose first half just ran */
+            uint8_t fused{0};
+
+#define _aoc_computer_dispatch() \
+    do { d = &fetch(); goto *dispatch_table[d->slot]; } while (0)
+#define _aoc_computer_op(label, code, handler, ends_block) \
+    label: {                                                \
+        handler(*this, *d);                                 \
+        if (pause(code)) {                                  \
+            set_flags(CF_PAUSED);                           \
+            return;                                         \
+        }                                                   \
+        if (ends_block && accel)                            \
+            accel->run(*this);                              \
+        _aoc_computer_dispatch();                           \
+    }
+#define _aoc_computer_fused(label, code, handler) \
+    label: {                                       \
+        fused = d->slot;                           \
+        handler(*this, *d);                        \
+        if (pause(code)) {                         \
+            set_flags(CF_PAUSED);                  \
+            return;                                \
+        }                                          \
+        goto fused_second;                         \
+    }
+
+            if (accel)
+                accel->run(*this);
+            _aoc_computer_dispatch();
+            _aoc_computer_op(op_add, OP_ADD, icb_add, false)
+            _aoc_computer_op(op_mul, OP_MUL, icb_mul, false)
+            _aoc_computer_op(op_in,  OP_IN,  icb_in,  true)
+            _aoc_computer_op(op_out, OP_OUT, icb_out, true)
+            _aoc_computer_op(op_jnz, OP_JNZ, icb_jnz, true)
+            _aoc_computer_op(op_jz,  OP_JZ,  icb_jz,  true)
+            _aoc_computer_op(op_lt,  OP_LT,  icb_lt,  false)
+            _aoc_computer_op(op_eq,  OP_EQ,  icb_eq,  false)
+            _aoc_computer_op(op_srb, OP_SRB, icb_srb, false)
+            _aoc_computer_fused(op_lt_jump,  OP_LT,  icb_lt)
+            _aoc_computer_fused(op_eq_jump,  OP_EQ,  icb_eq)
+            _aoc_computer_fused(op_add_jump, OP_ADD, icb_add)
+            _aoc_computer_fused(op_srb_jump, OP_SRB, icb_srb)
+            _aoc_computer_op(op_counter, OP_ADD, icb_counter, false)
+            /*
+             * The jump is only dispatched straight from its decode cache entry while that is still valid
+             * (the first half may even have overwritten it); otherwise it goes through fetch() again.
+             */
+        fused_second:
+            d = &decoded_[size_t(ip())];
+            if (!d->handler) [[unlikely]] {
+                count_fusion(fused, false);
+                _aoc_computer_dispatch();
+            }
+            count_fusion(fused, d->code == ((fused - DS_LT_JNZ) & 1 ? OP_JZ : OP_JNZ));
+            goto *dispatch_table[d->slot];
+        op_hlt:
+            icb_hlt(*this, *d);
+            if (pause(OP_HLT))
+                set_flags(CF_PAUSED);
+            return;
+        op_inval:
+            icb_invalid_instruction(*this, *d);
+
+#undef _aoc_computer_fused
+#undef _aoc_computer_op
+#undef _aoc_computer_dispatch
+#else
+            if (accel)
+                accel->run(*this);
+            while (!has_flags(CF_HALTED)) {
+                const auto& d = fetch();
+                auto code = instruction_code(d.code);
+                d.handler(*this, d);
+                if (pause(code)) {
+                    set_flags(CF_PAUSED);
+                    return;
+                }
+                if (accel && (code == OP_IN || code == OP_OUT || code == OP_JNZ || code == OP_JZ))
+                    accel->run(*this);
+            }
+#endif
+        }
+
+        /* `slot` is that of the superinstruction (the dispatch slots are in the same order) */
+        inline void count_fusion([[maybe_unused]] uint8_t slot, [[maybe_unused]] bool fired) {
+            if constexpr (policy::counting) {
+                auto si = fusion_counters::superinstruction(slot - DS_LT_JNZ);
+                if (fired)
+                    fusions_.fired(si);
+                else
+                    fusions_.missed(si);
+            }
         }
 
-        [[noreturn]] static inline void icb_invalid_instruction(computer& c, memory_value_t) {
-            fmt::print(::stderr, "INVALID INSTRUCTION at IP={}:\n{}\n", c.ip(), c.memory());
+        [[noreturn]] static inline void icb_invalid_instruction(basic_computer& c, const decoded_instruction_t&) {
+            fmt::print(::stderr, "INVALID INSTRUCTION at IP={}:\n{}\n", c.ip(), c.memory().to_vector());
             std::abort();
         }
-        static inline void icb_add(computer& c, memory_value_t modes) {
-            auto& in1 = c.mem_ref(c.ip() + 1, mode_for<1, 3>(modes));
-            auto& in2 = c.mem_ref(c.ip() + 2, mode_for<2, 3>(modes));
-            auto& out = c.mem_ref(c.ip() + 3, mode_for<3, 3>(modes));
-            out = in1 + in2;
+        static inline void icb_add(basic_computer& c, const decoded_instruction_t& d) {
+            auto in1 = c.load(c.ip() + 1, d.mode(0));
+            auto in2 = c.load(c.ip() + 2, d.mode(1));
+            c.store(c.ip() + 3, d.mode(2), in1 + in2);
             c.ip() += 4;
         }
-        static inline void icb_mul(computer& c, memory_value_t modes) {
-            auto& in1 = c.mem_ref(c.ip() + 1, mode_for<1, 3>(modes));
-            auto& in2 = c.mem_ref(c.ip() + 2, mode_for<2, 3>(modes));
-            auto& out = c.mem_ref(c.ip() + 3, mode_for<3, 3>(modes));
-            out = in1 * in2;
+        /* ADD x,imm,x resolves x once, unless its two parameter words have been patched apart */
+        static inline void icb_counter(basic_computer& c, const decoded_instruction_t& d) {
+            auto x = c.read(c.ip() + 3);
+            if (c.read(c.ip() + 1 + d.cell) != x) [[unlikely]] {
+                c.count_fusion(DS_COUNTER, false);
+                return icb_add(c, d);
+            }
+            c.count_fusion(DS_COUNTER, true);
+            if (d.mode(2) == AM_RELBASE)
+                x += c.reg_ref<RC_RELBASE>();
+            c.store_at(x, c.read(x) + c.read(c.ip() + 2 - d.cell));
+            c.ip() += 4;
+        }
+        static inline void icb_mul(basic_computer& c, const decoded_instruction_t& d) {
+            auto in1 = c.load(c.ip() + 1, d.mode(0));
+            auto in2 = c.load(c.ip() + 2, d.mode(1));
+            c.store(c.ip() + 3, d.mode(2), in1 * in2);
             c.ip() += 4;
         }
-        static inline void icb_in(computer& c, memory_value_t modes) {
-            auto& out = c.mem_ref(c.ip() + 1, mode_for<1, 1>(modes));
-            if (c.inputs_.empty() && c.has_flags(CF_DEFAULT_INPUT))
-                out = c.reg_ref<RC_DEFAULT_INPUT>();
-            else {
-                out = c.inputs_.front();
+        static inline void icb_in(basic_computer& c, const decoded_instruction_t& d) {
+            memory_value_t in1{};
+            [[maybe_unused]] bool from_queue{true};
+            if constexpr (policy::checkpointing) {
+                /* re-running the tail of a rewind takes the inputs it took the first time */
+                if (c.rewind_.replay < c.rewind_.replay_end) [[unlikely]] {
+                    const auto& in = c.rewind_.replayed[c.rewind_.replay++];
+                    c.rewind_.inputs.push_back(in);
+                    c.store(c.ip() + 1, d.mode(0), in.value);
+                    c.ip() += 2;
+                    return;
+                }
+            }
+            if (c.inputs_.empty() && c.has_flags(CF_DEFAULT_INPUT)) {
+                from_queue = false;
+                in1 = c.reg_ref<RC_DEFAULT_INPUT>();
+                if (c.has_flags(CF_UNTIL_BLOCKED))
+                    c.set_flags(CF_NEEDS_INPUT);
+            } else if (c.inputs_.empty() && c.has_flags(CF_UNTIL_BLOCKED)) {
+                c.set_flags(CF_NEEDS_INPUT);
+                if constexpr (policy::recording)
+                    c.trace_.unstep();
+                if constexpr (policy::checkpointing)
+                    c.rewind_.instructions -= 1;
+                return;
+            } else if (c.has_flags(CF_BLOCKING_IO)) {
+                std::optional<memory_value_t> v{};
+                while (!(v = c.inputs_.try_pop()))
+                    std::this_thread::yield();
+                in1 = *v;
+            } else if (c.inputs_.empty()) {
+                fmt::print(::stderr, "NO INPUT at IP={}\n", c.ip());
+                std::abort();
+            } else {
+                in1 = c.inputs_.front();
                 c.inputs_.pop_front();
             }
+            if constexpr (policy::recording)
+                c.trace_.input(in1);
+            if constexpr (policy::checkpointing)
+                c.rewind_.inputs.push_back({c.rewind_.instructions - 1, in1, from_queue});
+            c.store(c.ip() + 1, d.mode(0), in1);
             c.ip() += 2;
         }
-        static inline void icb_out(computer& c, memory_value_t modes) {
-            auto& in1 = c.mem_ref(c.ip() + 1, mode_for<1, 1>(modes));
-            c.outputs_.push_back(in1);
+        static inline void icb_out(basic_computer& c, const decoded_instruction_t& d) {
+            auto out1 = c.load(c.ip() + 1, d.mode(0));
+            if constexpr (policy::recording)
+                c.trace_.output(out1);
+            if constexpr (policy::checkpointing) {
+                c.rewind_.outputs += 1;
+                if (c.rewind_.replaying) {
+                    c.ip() += 2;
+                    return;
+                }
+            }
+            if (c.has_flags(CF_BLOCKING_IO)) {
+                while (!c.outputs_.try_push(out1))
+                    std::this_thread::yield();
+            } else {
+                c.outputs_.push_back(out1);
+            }
             c.ip() += 2;
         }
-        static inline void icb_jnz(computer& c, memory_value_t modes) {
-            auto& in1 = c.mem_ref(c.ip() + 1, mode_for<1, 2>(modes));
-            auto& in2 = c.mem_ref(c.ip() + 2, mode_for<2, 2>(modes));
+        static inline void icb_jnz(basic_computer& c, const decoded_instruction_t& d) {
+            auto in1 = c.load(c.ip() + 1, d.mode(0));
+            auto in2 = c.load(c.ip() + 2, d.mode(1));
             if (in1)
                 c.ip() = in2;
             else
                 c.ip() += 3;
         }
-        static inline void icb_jz(computer& c, memory_value_t modes) {
-            auto& in1 = c.mem_ref(c.ip() + 1, mode_for<1, 2>(modes));
-            auto& in2 = c.mem_ref(c.ip() + 2, mode_for<2, 2>(modes));
+        static inline void icb_jz(basic_computer& c, const decoded_instruction_t& d) {
+            auto in1 = c.load(c.ip() + 1, d.mode(0));
+            auto in2 = c.load(c.ip() + 2, d.mode(1));
             if (!in1)
                 c.ip() = in2;
             else
                 c.ip() += 3;
         }
-        static inline void icb_lt(computer& c, memory_value_t modes) {
-            auto& in1 = c.mem_ref(c.ip() + 1, mode_for<1, 3>(modes));
-            auto& in2 = c.mem_ref(c.ip() + 2, mode_for<2, 3>(modes));
-            auto& out = c.mem_ref(c.ip() + 3, mode_for<3, 3>(modes));
-            out = in1 < in2 ? 1 : 0;
+        static inline void icb_lt(basic_computer& c, const decoded_instruction_t& d) {
+            auto in1 = c.load(c.ip() + 1, d.mode(0));
+            auto in2 = c.load(c.ip() + 2, d.mode(1));
+            c.store(c.ip() + 3, d.mode(2), in1 < in2 ? 1 : 0);
             c.ip() += 4;
         }
-        static inline void icb_eq(computer& c, memory_value_t modes) {
-            auto& in1 = c.mem_ref(c.ip() + 1, mode_for<1, 3>(modes));
-            auto& in2 = c.mem_ref(c.ip() + 2, mode_for<2, 3>(modes));
-            auto& out = c.mem_ref(c.ip() + 3, mode_for<3, 3>(modes));
-            out = in1 == in2 ? 1 : 0;
+        static inline void icb_eq(basic_computer& c, const decoded_instruction_t& d) {
+            auto in1 = c.load(c.ip() + 1, d.mode(0));
+            auto in2 = c.load(c.ip() + 2, d.mode(1));
+            c.store(c.ip() + 3, d.mode(2), in1 == in2 ? 1 : 0);
             c.ip() += 4;
         }
-        static inline void icb_srb(computer& c, memory_value_t modes) {
-            auto& in1 = c.mem_ref(c.ip() + 1, mode_for<1, 1>(modes));
+        static inline void icb_srb(basic_computer& c, const decoded_instruction_t& d) {
+            auto in1 = c.load(c.ip() + 1, d.mode(0));
+            if constexpr (policy::recording)
+                c.trace_.relbase(in1);
             c.reg_ref<RC_RELBASE>() += in1;
             c.ip() += 2;
         }
-        static inline void icb_hlt(computer& c, memory_value_t) {
+        static inline void icb_hlt(basic_computer& c, const decoded_instruction_t&) {
             c.set_flags(CF_HALTED);
             c.ip() += 1;
         }
 
-        using instruction_callback_t = void (*)(computer&, memory_value_t);
         using instruction_callbacks_t = detail::instruction_callback_storage<instruction_callback_t, OP_INVAL>;
         static inline constexpr const auto instruction_callbacks = instruction_callbacks_t(
-                    &computer::icb_invalid_instruction, {
-                        {OP_ADD, &computer::icb_add},
-                        {OP_MUL, &computer::icb_mul},
-                        {OP_IN,  &computer::icb_in},
-                        {OP_OUT, &computer::icb_out},
-                        {OP_JNZ, &computer::icb_jnz},
-                        {OP_JZ,  &computer::icb_jz},
-                        {OP_LT,  &computer::icb_lt},
-                        {OP_EQ,  &computer::icb_eq},
-                        {OP_SRB, &computer::icb_srb},
-                        {OP_HLT, &computer::icb_hlt},
+                    &basic_computer::icb_invalid_instruction, {
+                        {OP_ADD, &basic_computer::icb_add},
+                        {OP_MUL, &basic_computer::icb_mul},
+                        {OP_IN,  &basic_computer::icb_in},
+                        {OP_OUT, &basic_computer::icb_out},
+                        {OP_JNZ, &basic_computer::icb_jnz},
+                        {OP_JZ,  &basic_computer::icb_jz},
+                        {OP_LT,  &basic_computer::icb_lt},
+                        {OP_EQ,  &basic_computer::icb_eq},
+                        {OP_SRB, &basic_computer::icb_srb},
+                        {OP_HLT, &basic_computer::icb_hlt},
+                    });
+        /* what decode() makes of an opcode it does not know */
+        static inline constexpr const decoded_instruction_t invalid_instruction{&basic_computer::icb_invalid_instruction, uint8_t(OP_INVAL),
+                                                                                DS_INVAL, 1, {}, 0};
+        using instruction_lengths_t = detail::instruction_callback_storage<memory_value_t, OP_INVAL>;
+        static inline constexpr const auto instruction_lengths = instruction_lengths_t(
+                    0, {
+                        {OP_ADD, 4},
+                        {OP_MUL, 4},
+                        {OP_IN,  2},
+                        {OP_OUT, 2},
+                        {OP_JNZ, 3},
+                        {OP_JZ,  3},
+                        {OP_LT,  4},
+                        {OP_EQ,  4},
+                        {OP_SRB, 2},
+                        {OP_HLT, 1},
                     });
 
         std::array<memory_value_t, register_code::RC_MAX_> registers_{};
-        std::deque<memory_value_t> inputs_{};
-        std::deque<memory_value_t> outputs_{};
+        detail::ring_buffer<memory_value_t> inputs_{};
+        detail::ring_buffer<memory_value_t> outputs_{};
         memory_value_t flags_{0};
-        std::vector<memory_value_t> memory_{};
+        /* CF_HALTED again, for other threads */
+        detail::shared_flag halted_{};
+        memory_t memory_{};
+        std::vector<decoded_instruction_t> decoded_{};
+        static constexpr const char snapshot_magic[8] = {'A', 'O', 'C', 'S', 'N', 'A', 'P', 0};
+        static constexpr const uint32_t snapshot_version = 1;
+        static constexpr const size_t snapshot_alignment = 4096;
+
+        /* followed by the inputs, outputs and page numbers (one uint64_t each) and, at data_offset, the pages */
+        struct snapshot_header {
+            char magic[8];
+            uint32_t version;
+            uint32_t page_words;
+            memory_value_t registers[RC_MAX_];
+            memory_value_t flags;
+            uint64_t memory_size;
+            uint64_t inputs;
+            uint64_t outputs;
+            uint64_t pages;
+            uint64_t data_offset;
+        };
+
+        struct checkpoint_t {
+            uint64_t instructions;
+            size_t inputs;
+            uint64_t outputs;
+            std::array<memory_value_t, register_code::RC_MAX_> registers;
+            memory_t memory;
+        };
+        struct input_record {
+            uint64_t instruction;
+            memory_value_t value;
+            /* false for the default input, which is not put back in the queue on a rewind */
+            bool from_queue;
+        };
+        struct rewind_log {
+            std::vector<checkpoint_t> checkpoints{};
+            std::vector<input_record> inputs{};
+            uint64_t instructions{0};
+            uint64_t outputs{0};
+            uint64_t every{uint64_t(1) << 16};
+            uint64_t next{0};
+            size_t budget{64};
+            bool at_inputs{true};
+            /* the logged inputs a rewind is feeding back, replayed[replay, replay_end) still to go */
+            std::vector<input_record> replayed{};
+            size_t replay{0};
+            size_t replay_end{0};
+            bool replaying{false};
+
+            void clear() {
+                checkpoints.clear();
+                inputs.clear();
+                instructions = outputs = next = 0;
+            }
+        };
+
+        void checkpoint() {
+            auto& r = rewind_;
+            r.next = r.every ? r.instructions + r.every : std::numeric_limits<uint64_t>::max();
+            /* an IN which gave up comes back with the same count */
+            if (!r.checkpoints.empty() && r.checkpoints.back().instructions == r.instructions)
+                return;
+            r.checkpoints.push_back({r.instructions, r.inputs.size(), r.outputs, registers_, memory_});
+            if (r.checkpoints.size() > r.budget) {
+                size_t keep{1};
+                for (size_t idx = 1; idx < r.checkpoints.size(); idx++) {
+                    if (!(idx & 1) || idx + 1 == r.checkpoints.size())
+                        r.checkpoints[keep++] = std::move(r.checkpoints[idx]);
+                }
+                r.checkpoints.erase(r.checkpoints.begin() + ptrdiff_t(keep), r.checkpoints.end());
+            }
+        }
+
+        void rewind(uint64_t count, bool requeue) {
+            auto& r = rewind_;
+            if (count > r.instructions) {
+                fmt::print(::stderr, "CANNOT REWIND FORWARD TO {} FROM {}\n", count, r.instructions);
+                std::abort();
+            }
+            auto it = std::upper_bound(r.checkpoints.begin(), r.checkpoints.end(), count,
+                                       [](uint64_t c, const checkpoint_t& cp) { return c < cp.instructions; });
+            if (it == r.checkpoints.begin()) {
+                fmt::print(::stderr, "CANNOT REWIND TO {}, NO CHECKPOINT AT OR BEFORE IT\n", count);
+                std::abort();
+            }
+            const auto& cp = *--it;
+
+            /* split the inputs consumed since the checkpoint into the ones the tail takes again and the rest */
+            auto end = std::partition_point(r.inputs.begin() + ptrdiff_t(cp.inputs), r.inputs.end(),
+                                            [count](const input_record& in) { return in.instruction < count; });
+            if (requeue) {
+                detail::ring_buffer<memory_value_t> queue{};
+                for (auto in = end; in != r.inputs.end(); in++) {
+                    if (in->from_queue)
+                        queue.push_back(in->value);
+                }
+                for (auto v : inputs_)
+                    queue.push_back(v);
+                inputs_ = std::move(queue);
+            }
+            r.replayed.assign(r.inputs.begin() + ptrdiff_t(cp.inputs), end);
+            r.replay = 0;
+            r.replay_end = r.replayed.size();
+            r.inputs.resize(cp.inputs);
+
+            auto outputs = r.outputs;
+            registers_ = cp.registers;
+            memory_.assign(cp.memory, [this](size_t page) {
+                invalidate_decoded(page << memory_t::page_bits, memory_t::page_size);
+                if (accel_)
+                    accel_->invalidate(page << memory_t::page_bits, memory_t::page_size);
+            });
+            r.instructions = cp.instructions;
+            r.outputs = cp.outputs;
+            r.next = r.every ? cp.instructions + r.every : std::numeric_limits<uint64_t>::max();
+            r.checkpoints.erase(it + 1, r.checkpoints.end());
+            clear_flags(CF_HALTED | CF_PAUSED | CF_NEEDS_INPUT);
+
+            r.replaying = true;
+            while (r.instructions < count)
+                single_step();
+            r.replaying = false;
+            r.replayed.clear();
+            r.replay = r.replay_end = 0;
+
+            auto keep = outputs_.size() - std::min<size_t>(outputs_.size(), size_t(outputs - r.outputs));
+            if (keep < outputs_.size()) {
+                detail::ring_buffer<memory_value_t> queue{};
+                for (size_t idx = 0; idx < keep; idx++)
+                    queue.push_back(outputs_[idx]);
+                outputs_ = std::move(queue);
+            }
+        }
+
+        detail::cloning_ptr<accelerator> accel_{};
+        [[no_unique_address]] std::conditional_t<policy::profiling, execution_profile, std::monostate> profile_{};
+        [[no_unique_address]] std::conditional_t<policy::sampling, execution_sampler, std::monostate> sampler_{};
+        [[no_unique_address]] std::conditional_t<policy::recording, trace_recorder, std::monostate> trace_{};
+        [[no_unique_address]] std::conditional_t<policy::checkpointing, rewind_log, std::monostate> rewind_{};
+        [[no_unique_address]] std::conditional_t<policy::counting, fusion_counters, std::monostate> fusions_{};
+    };
+
+    using computer = basic_computer<checked_policy>;
+
+    /*
+     * Computers which all start out as the same image. A lease hands one out and gives it back, reset to
+     * the image, when it goes away, so the pool only allocates while it grows. Not thread safe.
+     */
+    class computer_pool {
+    public:
+        class lease {
+        public:
+            lease(const lease&) = delete;
+            lease& operator=(const lease&) = delete;
+            lease(lease&& other) noexcept : pool_(std::exchange(other.pool_, nullptr)), vm_(other.vm_) {}
+            ~lease() {
+                if (pool_)
+                    pool_->release(vm_);
+            }
+
+            inline computer& operator*() const { return *vm_; }
+            inline computer* operator->() const { return vm_; }
+
+        private:
+            friend class computer_pool;
+            lease(computer_pool* pool, computer* vm) : pool_(pool), vm_(vm) {}
+
+            computer_pool* pool_;
+            computer* vm_;
+        };
+
+        explicit computer_pool(const computer& image, size_t initial_size = 0)
+            : image_(image.fork())
+        {
+            image_.set_baseline();
+            for (size_t idx = 0; idx < initial_size; idx++)
+                free_.push_back(&vms_.emplace_back(image_.fork()));
+        }
+        computer_pool(const computer_pool&) = delete;
+        computer_pool& operator=(const computer_pool&) = delete;
+
+        lease acquire() {
+            if (free_.empty())
+                return lease(this, &vms_.emplace_back(image_.fork()));
+            auto vm = free_.back();
+            free_.pop_back();
+            return lease(this, vm);
+        }
+
+        inline size_t size() const {
+            return vms_.size();
+        }
+
+    private:
+        inline void release(computer* vm) {
+            vm->reset_to_baseline();
+            free_.push_back(vm);
+        }
+
+        computer image_;
+        std::deque<computer> vms_{};
+        std::vector<computer*> free_{};
+    };
+}
+
+namespace fmt {
+    template <typename T>
+    struct formatter<aoc::detail::ring_buffer<T>> : formatter<std::vector<T>> {
+        template <typename FormatContext>
+        auto format(const aoc::detail::ring_buffer<T>& rb, FormatContext &ctx) {
+            return formatter<std::vector<T>>::format(std::vector<T>(rb.begin(), rb.end()), ctx);
+        }
+    };
+
+    template <typename T>
+    struct formatter<aoc::detail::paged_memory<T>> : formatter<std::vector<T>> {
+        template <typename FormatContext>
+        auto format(const aoc::detail::paged_memory<T>& m, FormatContext &ctx) {
+            return formatter<std::vector<T>>::format(m.to_vector(), ctx);
+        }
     };
 }
@@ -0,0 +1,598 @@
+#pragma once
+
+#include "computer.h"
+
+#include <map>
+#include <set>
+
+/*
+ * Static analysis of a program image, without running it. Instructions are found by recursive descent
+ * from address 0, following immediate jump targets, the fallthrough of jumps whose condition is not a
+ * constant, the return addresses pushed in front of a call (an ADD/MUL of two immediates stored to the
+ * top of the stack right before an unconditional jump) and constants which look like code pointers.
+ * Whatever is only reached through a computed jump is not found, so "data" means "not shown to be code".
+ *
+ * Calls split the code into functions. Within one the relative base is followed as an offset from its
+ * value at entry, which gives every stack access an offset and every call the depth it is made at; the
+ * call graph then bounds how far above 0 the stack can reach. Recursion, an SRB by a computed amount or
+ * a function which returns with a different relative base than it got make that bound unknown, as does
+ * any access through a pointer the program patches into its own code or below address 0. An indirect jump
+ * has to be a call through a taken address or a return through the slot its caller pushed the return
+ * address to; one going anywhere else may run code nothing was found for, so that makes it unknown too. So does control reaching a word
+ * which does not decode, or a block running off into one: such a word is usually patched before it runs,
+ * so whatever follows it is code nothing was found for.
+ */
+
+namespace aoc {
+    class program_analysis {
+    public:
+        using value_t = computer::memory_value_t;
+
+        enum address_kind : uint8_t {
+            AK_DATA = 0,
+            AK_OPCODE = 1 << 0,
+            AK_OPERAND = 1 << 1,
+            /* a reachable instruction stores to it through a constant address */
+            AK_WRITTEN = 1 << 2,
+        };
+
+        enum block_exit : uint8_t {
+            BX_FALLTHROUGH,
+            BX_BRANCH,
+            BX_JUMP,
+            BX_CALL,
+            BX_INDIRECT,
+            BX_HALT,
+            BX_INVALID,
+        };
+
+        struct instruction_t {
+            size_t address;
+            computer::instruction_code code;
+            size_t length;
+            std::array<computer::addressing_mode, 3> modes;
+            std::array<value_t, 3> params;
+        };
+
+        struct block_t {
+            size_t first;
+            /* address of the last instruction and one past its last word */
+            size_t last;
+            size_t end;
+            block_exit exit;
+            /* statically known targets; the callee for a call, whose return site is kept apart */
+            std::vector<size_t> successors;
+            std::optional<size_t> return_site;
+        };
+
+        struct function_t {
+            size_t entry;
+            std::vector<size_t> blocks;
+            std::set<size_t> callees;
+            /* highest stack offset the function itself touches, relative to the relative base at entry */
+            std::optional<value_t> frame;
+            /* range of relative base values the function can be entered with */
+            std::optional<std::pair<value_t, value_t>> base;
+        };
+
+        explicit program_analysis(std::vector<value_t> image)
+            : image_(std::move(image))
+            , kind_(image_.size(), AK_DATA)
+        {
+            discover();
+            split_blocks();
+            find_functions();
+            for (auto& [entry, f] : functions_)
+                walk_function(f);
+            propagate_bases();
+            find_accesses();
+        }
+        template <typename policy>
+        explicit program_analysis(const basic_computer<policy>& c)
+            : program_analysis(c.memory().to_vector())
+        {}
+
+        inline const std::vector<value_t>& image() const {
+            return image_;
+        }
+        inline const std::map<size_t, instruction_t>& instructions() const {
+            return instructions_;
+        }
+        inline const std::map<size_t, block_t>& blocks() const {
+            return blocks_;
+        }
+        inline const std::map<size_t, function_t>& functions() const {
+            return functions_;
+        }
+
+        inline uint8_t kind(size_t address) const {
+            return address < kind_.size() ? kind_[address] : uint8_t(AK_DATA);
+        }
+        inline bool is_code(size_t address) const {
+            return kind(address) & (AK_OPCODE | AK_OPERAND);
+        }
+        inline bool is_instruction_start(size_t address) const {
+            return kind(address) & AK_OPCODE;
+        }
+        /* words decoded both as an opcode and as a parameter of another instruction */
+        inline const std::vector<size_t>& overlaps() const {
+            return overlaps_;
+        }
+        /* code words some instruction stores to through a constant address */
+        inline const std::vector<size_t>& written_code() const {
+            return written_code_;
+        }
+        /* true if a constant store lands on an opcode, or on a word discovery stopped at, rather than on a parameter */
+        inline bool rewrites_opcodes() const {
+            return std::any_of(written_code_.begin(), written_code_.end(),
+                               [this](size_t a) { return (kind_[a] & AK_OPCODE) || undecodable_.count(a); });
+        }
+        /* instructions with an operand patched by the program, whose address is therefore not known */
+        inline const std::vector<size_t>& patched_accesses() const {
+            return patched_accesses_;
+        }
+        /* jumps whose target is read from memory */
+        inline const std::vector<size_t>& indirect_jumps() const {
+            return indirect_jumps_;
+        }
+        /* indirect jumps which are neither a call through a taken address nor a return */
+        inline const std::set<size_t>& unresolved_jumps() const {
+            return unresolved_jumps_;
+        }
+        /* instructions with a constant address below 0, or a stack access which can end up there */
+        inline const std::set<size_t>& negative_accesses() const {
+            return negative_accesses_;
+        }
+        /* blocks which exit BX_INVALID, and the words control reaches which do not decode */
+        inline const std::vector<size_t>& invalid_exits() const {
+            return invalid_exits_;
+        }
+        inline const std::set<size_t>& undecodable() const {
+            return undecodable_;
+        }
+
+        /* highest address the image and the instructions found reach through constant or stack addresses */
+        inline size_t highest_known_address() const {
+            return highest_known_;
+        }
+        /* lowest address of a stack store, if the stack is bounded; above image().size() means it never hits the image */
+        inline std::optional<value_t> lowest_stack_store() const {
+            return lowest_stack_store_;
+        }
+        /* highest address the program can touch, when nothing it does escapes the analysis */
+        inline std::optional<size_t> highest_address() const {
+            if (unknown_because())
+                return std::nullopt;
+            return highest_known_;
+        }
+        /* true if an unchecked_policy<words> computer can run the program */
+        inline bool fits(size_t words) const {
+            auto h = highest_address();
+            return h && *h < words;
+        }
+
+        void report(FILE* out) const {
+            size_t code{0};
+            for (auto k : kind_)
+                code += bool(k & (AK_OPCODE | AK_OPERAND));
+            fmt::print(out, "{} words, {} code, {} data\n", image_.size(), code, image_.size() - code);
+            fmt::print(out, "{} instructions in {} blocks, {} functions\n", instructions_.size(), blocks_.size(), functions_.size());
+            fmt::print(out, "{} indirect jumps ({} unresolved), {} overlapping words\n", indirect_jumps_.size(),
+                       unresolved_jumps_.size(), overlaps_.size());
+            fmt::print(out, "{} invalid block exits, {} undecodable words reached\n", invalid_exits_.size(), undecodable_.size());
+            fmt::print(out, "{} code words written ({}), {} accesses through patched operands\n", written_code_.size(),
+                       rewrites_opcodes() ? "opcodes too" : "operands only", patched_accesses_.size());
+            for (const auto& [entry, f] : functions_) {
+                fmt::print(out, "  fn {:>5}: {:>3} blocks, frame {:>4}, base {}\n", entry, f.blocks.size(),
+                           f.frame ? fmt::format("{}", *f.frame) : std::string{"?"},
+                           f.base ? fmt::format("{}..{}", f.base->first, f.base->second) : std::string{"?"});
+            }
+            fmt::print(out, "highest known address {}, highest address {}\n", highest_known_,
+                       highest_address() ? fmt::format("{}", *highest_address()) : fmt::format("unknown ({})", unknown_because()));
+        }
+
+    private:
+        /* why highest_address() is not known, null if it is */
+        inline const char* unknown_because() const {
+            if (!undecodable_.empty() || !invalid_exits_.empty())
+                return "undecodable code";
+            if (rewrites_opcodes())
+                return "rewritten opcodes";
+            if (!patched_accesses_.empty())
+                return "patched operands";
+            if (!unresolved_jumps_.empty())
+                return "unresolved indirect jumps";
+            if (!negative_accesses_.empty())
+                return "negative addresses";
+            if (!stack_bounded_)
+                return "stack";
+            return nullptr;
+        }
+
+        std::optional<instruction_t> decode(size_t address) const {
+            if (address >= image_.size() || image_[address] <= 0)
+                return std::nullopt;
+            auto raw = image_[address];
+            auto code = computer::instruction_code(raw % 100);
+            size_t length{0};
+            switch (code) {
+                case computer::OP_ADD: case computer::OP_MUL: case computer::OP_LT: case computer::OP_EQ: length = 4; break;
+                case computer::OP_JNZ: case computer::OP_JZ: length = 3; break;
+                case computer::OP_IN: case computer::OP_OUT: case computer::OP_SRB: length = 2; break;
+                case computer::OP_HLT: length = 1; break;
+                default: return std::nullopt;
+            }
+            if (address + length > image_.size())
+                return std::nullopt;
+
+            instruction_t ret{address, code, length, {}, {}};
+            auto modes = raw / 100;
+            for (size_t p = 0; p + 1 < length; p++, modes /= 10) {
+                if (modes % 10 >= computer::AM_MAX_ || (p == stored(code) && modes % 10 == computer::AM_IMMEDIATE))
+                    return std::nullopt;
+                ret.modes[p] = computer::addressing_mode(modes % 10);
+                ret.params[p] = image_[address + 1 + p];
+            }
+            return modes ? std::nullopt : std::optional<instruction_t>{ret};
+        }
+
+        /* index of the parameter an instruction stores to, 3 if none */
+        static inline size_t stored(computer::instruction_code code) {
+            switch (code) {
+                case computer::OP_ADD: case computer::OP_MUL: case computer::OP_LT: case computer::OP_EQ: return 2;
+                case computer::OP_IN: return 0;
+                default: return 3;
+            }
+        }
+        static inline bool is_jump(const instruction_t& ins) {
+            return ins.code == computer::OP_JNZ || ins.code == computer::OP_JZ;
+        }
+        /* taken, not taken or unknown for a jump */
+        static inline std::optional<bool> taken(const instruction_t& ins) {
+            if (ins.modes[0] != computer::AM_IMMEDIATE)
+                return std::nullopt;
+            return (ins.params[0] != 0) == (ins.code == computer::OP_JNZ);
+        }
+        inline std::optional<size_t> direct_target(const instruction_t& ins) const {
+            if (ins.modes[1] != computer::AM_IMMEDIATE || ins.params[1] < 0 || size_t(ins.params[1]) >= image_.size())
+                return std::nullopt;
+            return size_t(ins.params[1]);
+        }
+        /* the constant an ADD/MUL of two immediates stores */
+        static inline std::optional<value_t> stored_constant(const instruction_t& ins) {
+            if ((ins.code != computer::OP_ADD && ins.code != computer::OP_MUL) || ins.modes[0] != computer::AM_IMMEDIATE ||
+                ins.modes[1] != computer::AM_IMMEDIATE)
+                return std::nullopt;
+            return ins.code == computer::OP_ADD ? ins.params[0] + ins.params[1] : ins.params[0] * ins.params[1];
+        }
+
+        /* a code pointer has to decode up to an unconditional control transfer or known code without crossing it */
+        bool is_plausible_entry(size_t address) const {
+            while (auto ins = decode(address)) {
+                for (size_t w = address; w < address + ins->length; w++) {
+                    if (kind_[w])
+                        return w == address && (kind_[w] & AK_OPCODE);
+                }
+                if (ins->code == computer::OP_HLT || (is_jump(*ins) && taken(*ins) == true))
+                    return true;
+                address += ins->length;
+            }
+            return false;
+        }
+
+        void add(const instruction_t& ins) {
+            instructions_.emplace(ins.address, ins);
+            for (size_t w = ins.address; w < ins.address + ins.length; w++) {
+                auto k = w == ins.address ? AK_OPCODE : AK_OPERAND;
+                if (kind_[w] && kind_[w] != k)
+                    overlaps_.push_back(w);
+                kind_[w] |= k;
+            }
+        }
+
+        void discover() {
+            std::vector<size_t> pending{0};
+            std::set<size_t> constants{};
+            while (!pending.empty()) {
+                auto address = pending.back();
+                pending.pop_back();
+                std::optional<size_t> return_site{};
+                while (!instructions_.count(address)) {
+                    auto ins = decode(address);
+                    if (!ins) {
+                        undecodable_.insert(address);
+                        break;
+                    }
+                    add(*ins);
+                    auto next = address + ins->length;
+                    if (auto v = stored_constant(*ins); v && *v >= 0 && size_t(*v) < image_.size()) {
+                        constants.insert(size_t(*v));
+                        if (ins->modes[2] == computer::AM_RELBASE && ins->params[2] == 0)
+                            return_site = size_t(*v);
+                    }
+                    if (ins->code == computer::OP_HLT)
+                        break;
+                    if (is_jump(*ins)) {
+                        auto t = taken(*ins);
+                        auto target = direct_target(*ins);
+                        if (target && t != false)
+                            pending.push_back(*target);
+                        if (t == true) {
+                            if (return_site && (target || ins->modes[1] != computer::AM_IMMEDIATE)) {
+                                calls_.emplace(address, *return_site);
+                                pending.push_back(*return_site);
+                            }
+                            break;
+                        }
+                        return_site.reset();
+                    }
+                    address = next;
+                }
+
+                /* function pointers get passed around as constants too */
+                while (pending.empty() && !constants.empty()) {
+                    auto v = *constants.begin();
+                    constants.erase(constants.begin());
+                    if (!instructions_.count(v) && is_plausible_entry(v)) {
+                        address_taken_.insert(v);
+                        pending.push_back(v);
+                    }
+                }
+            }
+            std::sort(overlaps_.begin(), overlaps_.end());
+            overlaps_.erase(std::unique(overlaps_.begin(), overlaps_.end()), overlaps_.end());
+        }
+
+        void split_blocks() {
+            std::set<size_t> leaders{0};
+            for (const auto& [address, ins] : instructions_) {
+                if (!is_jump(ins))
+                    continue;
+                if (auto target = direct_target(ins); target && taken(ins) != false)
+                    leaders.insert(*target);
+                if (taken(ins) != true || calls_.count(address))
+                    leaders.insert(calls_.count(address) ? calls_.at(address) : address + ins.length);
+            }
+
+            block_t* current{nullptr};
+            for (const auto& [address, ins] : instructions_) {
+                if (!current || leaders.count(address) || current->end != address) {
+                    current = &blocks_.emplace(address, block_t{address, address, address, BX_FALLTHROUGH, {}, {}}).first->second;
+                }
+                current->last = address;
+                current->end = address + ins.length;
+                auto next = current->end;
+                auto ends = true;
+                if (ins.code == computer::OP_HLT) {
+                    current->exit = BX_HALT;
+                } else if (is_jump(ins)) {
+                    auto t = taken(ins);
+                    auto target = direct_target(ins);
+                    if (t == false) {
+                        ends = false;
+                    } else if (!target && ins.modes[1] != computer::AM_IMMEDIATE) {
+                        current->exit = BX_INDIRECT;
+                        indirect_jumps_.push_back(address);
+                        if (calls_.count(address))
+                            current->return_site = calls_.at(address);
+                    } else if (!target) {
+                        current->exit = BX_INVALID;
+                    } else if (t == true) {
+                        current->exit = calls_.count(address) ? BX_CALL : BX_JUMP;
+                        current->successors.push_back(*target);
+                        if (current->exit == BX_CALL)
+                            current->return_site = calls_.at(address);
+                    } else {
+                        current->exit = BX_BRANCH;
+                        current->successors.push_back(*target);
+                    }
+                    if (!t && instructions_.count(next))
+                        current->successors.push_back(next);
+                } else {
+                    ends = false;
+                }
+                if (!ends && (leaders.count(next) || !instructions_.count(next))) {
+                    current->exit = instructions_.count(next) ? BX_FALLTHROUGH : BX_INVALID;
+                    if (instructions_.count(next))
+                        current->successors.push_back(next);
+                    ends = true;
+                }
+                if (ends && current->exit == BX_INVALID)
+                    invalid_exits_.push_back(current->first);
+                if (ends)
+                    current = nullptr;
+            }
+        }
+
+        void find_functions() {
+            functions_.emplace(0, function_t{0, {}, {}, {}, {}});
+            for (const auto& [address, b] : blocks_) {
+                if (b.exit == BX_CALL)
+                    functions_.emplace(b.successors.front(), function_t{b.successors.front(), {}, {}, {}, {}});
+            }
+            for (auto address : address_taken_)
+                functions_.emplace(address, function_t{address, {}, {}, {}, {}});
+        }
+
+        /* collects the blocks of `f` and the offsets its stack accesses and calls are made at */
+        void walk_function(function_t& f) {
+            /* offset of the relative base from its value at entry; lost after an SRB by a computed amount */
+            std::map<size_t, std::optional<value_t>> delta{{f.entry, 0}};
+            std::vector<size_t> pending{f.entry};
+            value_t frame{std::numeric_limits<value_t>::min()};
+            auto balanced = true;
+            while (!pending.empty()) {
+                auto address = pending.back();
+                pending.pop_back();
+                auto it = blocks_.find(address);
+                if (it == blocks_.end()) {
+                    balanced = false;
+                    continue;
+                }
+                const auto& b = it->second;
+                f.blocks.push_back(address);
+                auto d = delta.at(address);
+                for (auto ia = instructions_.find(b.first); ia != instructions_.end() && ia->first <= b.last; ++ia) {
+                    const auto& ins = ia->second;
+                    for (size_t p = 0; p + 1 < ins.length; p++) {
+                        if (ins.modes[p] == computer::AM_RELBASE && d) {
+                            frame = std::max(frame, *d + ins.params[p]);
+                            stack_accesses_.push_back({f.entry, ins.address, *d + ins.params[p], p == stored(ins.code)});
+                        }
+                    }
+                    if (ins.code == computer::OP_SRB) {
+                        if (d && ins.modes[0] == computer::AM_IMMEDIATE) {
+                            *d += ins.params[0];
+                        } else {
+                            d.reset();
+                            balanced = false;
+                        }
+                    }
+                }
+                if (b.exit == BX_INDIRECT && !b.return_site) {
+                    /* an indirect jump which is not a call returns, with the relative base it was entered with */
+                    const auto& jump = instructions_.at(b.last);
+                    if (!f.entry || !d || jump.modes[1] != computer::AM_RELBASE || *d + jump.params[1] != 0)
+                        unresolved_jumps_.insert(b.last);
+                    if (f.entry && d != 0)
+                        balanced = false;
+                }
+                /* an indirect call may go to any function whose address is taken */
+                if (b.exit == BX_INDIRECT && b.return_site && address_taken_.empty())
+                    unresolved_jumps_.insert(b.last);
+                auto callees = b.exit == BX_CALL ? std::set<size_t>{b.successors.front()}
+                             : b.return_site ? address_taken_ : std::set<size_t>{};
+                for (auto callee : callees) {
+                    if (d)
+                        call_sites_.push_back({f.entry, callee, *d});
+                    f.callees.insert(callee);
+                }
+                auto follow = b.return_site ? std::vector<size_t>{*b.return_site} : b.successors;
+                for (auto s : follow) {
+                    auto [at, inserted] = delta.emplace(s, d);
+                    if (inserted)
+                        pending.push_back(s);
+                    else if (at->second != d)
+                        balanced = false;
+                }
+            }
+            std::sort(f.blocks.begin(), f.blocks.end());
+            if (balanced)
+                f.frame = std::max<value_t>(frame, 0);
+            else
+                unbalanced_.insert(f.entry);
+        }
+
+        /* relative base ranges at function entry, starting from 0 at address 0; grows forever on recursion */
+        void propagate_bases() {
+            functions_.at(0).base = std::pair<value_t, value_t>{0, 0};
+            stack_bounded_ = unbalanced_.empty();
+            for (size_t round = 0; stack_bounded_; round++) {
+                auto changed = false;
+                for (const auto& site : call_sites_) {
+                    const auto& caller = functions_.at(site.caller);
+                    if (!caller.base)
+                        continue;
+                    auto lo = caller.base->first + site.delta;
+                    auto hi = caller.base->second + site.delta;
+                    auto& callee = functions_.at(site.callee).base;
+                    if (!callee) {
+                        callee = std::pair<value_t, value_t>{lo, hi};
+                        changed = true;
+                    } else if (lo < callee->first || hi > callee->second) {
+                        callee = std::pair<value_t, value_t>{std::min(lo, callee->first), std::max(hi, callee->second)};
+                        changed = true;
+                    }
+                }
+                if (!changed)
+                    break;
+                if (round > functions_.size())
+                    stack_bounded_ = false;
+            }
+            if (!stack_bounded_) {
+                for (auto& [entry, f] : functions_)
+                    f.base.reset();
+            }
+        }
+
+        void find_accesses() {
+            highest_known_ = image_.empty() ? 0 : image_.size() - 1;
+            for (const auto& [address, ins] : instructions_) {
+                for (size_t p = 0; p + 1 < ins.length; p++) {
+                    if (ins.modes[p] != computer::AM_POSITION)
+                        continue;
+                    if (ins.params[p] < 0) {
+                        negative_accesses_.insert(address);
+                        continue;
+                    }
+                    auto target = size_t(ins.params[p]);
+                    highest_known_ = std::max(highest_known_, target);
+                    if (p == stored(ins.code) && target < kind_.size())
+                        kind_[target] |= AK_WRITTEN;
+                }
+            }
+            for (size_t address = 0; address < kind_.size(); address++) {
+                if ((kind_[address] & AK_WRITTEN) && ((kind_[address] & (AK_OPCODE | AK_OPERAND)) || undecodable_.count(address)))
+                    written_code_.push_back(address);
+            }
+            for (const auto& [address, ins] : instructions_) {
+                for (size_t p = 0; p + 1 < ins.length; p++) {
+                    if (ins.modes[p] != computer::AM_IMMEDIATE && (kind_[address + 1 + p] & AK_WRITTEN)) {
+                        patched_accesses_.push_back(address);
+                        break;
+                    }
+                }
+            }
+
+            if (!stack_bounded_)
+                return;
+            for (const auto& access : stack_accesses_) {
+                const auto& base = functions_.at(access.function).base;
+                if (!base)
+                    continue;
+                if (base->first + access.offset < 0)
+                    negative_accesses_.insert(access.address);
+                if (base->second + access.offset >= 0)
+                    highest_known_ = std::max(highest_known_, size_t(base->second + access.offset));
+                if (access.store && (!lowest_stack_store_ || base->first + access.offset < *lowest_stack_store_))
+                    lowest_stack_store_ = base->first + access.offset;
+            }
+        }
+
+        struct stack_access {
+            size_t function;
+            size_t address;
+            value_t offset;
+            bool store;
+        };
+        struct call_site {
+            size_t caller;
+            size_t callee;
+            value_t delta;
+        };
+
+        std::vector<value_t> image_;
+        std::vector<uint8_t> kind_;
+        std::map<size_t, instruction_t> instructions_{};
+        /* call jump -> return site */
+        std::map<size_t, size_t> calls_{};
+        /* constants found to point at code, assumed to be the targets of indirect calls */
+        std::set<size_t> address_taken_{};
+        std::map<size_t, block_t> blocks_{};
+        std::map<size_t, function_t> functions_{};
+        std::vector<stack_access> stack_accesses_{};
+        std::vector<call_site> call_sites_{};
+        std::set<size_t> unbalanced_{};
+        std::vector<size_t> overlaps_{};
+        std::vector<size_t> written_code_{};
+        std::vector<size_t> patched_accesses_{};
+        std::vector<size_t> indirect_jumps_{};
+        std::set<size_t> unresolved_jumps_{};
+        std::set<size_t> negative_accesses_{};
+        std::vector<size_t> invalid_exits_{};
+        std::set<size_t> undecodable_{};
+        size_t highest_known_{0};
+        std::optional<value_t> lowest_stack_store_{};
+        bool stack_bounded_{false};
+    };
+}
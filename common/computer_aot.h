@@ -0,0 +1,134 @@
+#pragma once
+
+#include "computer.h"
+
+/*
+ * Runtime side of the ahead-of-time Intcode compiler (tools/intcode2cpp). The generated translation unit
+ * derives from compiled_program, provides the image it was built from and the basic blocks it found in
+ * it, and defines aoc::make_compiled_program(). Days built with aoc_compiled_day() can then hand their
+ * computers over to it with enable_compiled_program().
+ *
+ * A block is only run while the memory it covers still matches the image (checked the first time it is
+ * entered, so a day which patches its program before running it is fine). Generated code never writes
+ * into a live block: it returns to the interpreter in front of such a write and the block is retired
+ * once the interpreter reports the write through invalidate().
+ */
+
+namespace aoc {
+    class compiled_program : public computer::accelerator {
+    public:
+        using memory_value_t = computer::memory_value_t;
+
+        struct block_t {
+            size_t start;
+            size_t end;
+        };
+
+        bool handles(computer::instruction_code code) const override {
+            switch (code) {
+                case computer::OP_ADD: [[fallthrough]];
+                case computer::OP_MUL: [[fallthrough]];
+                case computer::OP_JNZ: [[fallthrough]];
+                case computer::OP_JZ: [[fallthrough]];
+                case computer::OP_LT: [[fallthrough]];
+                case computer::OP_EQ: [[fallthrough]];
+                case computer::OP_SRB: return true;
+                default: return false;
+            }
+        }
+
+        void invalidate(size_t address, size_t count) override {
+            auto last = std::min(image_size_, address + count);
+            for (auto addr = address; addr < last; addr++) {
+                if (!code_map_[addr])
+                    continue;
+                for (size_t idx = 0; idx < block_count_; idx++) {
+                    if (blocks_[idx].start <= addr && addr < blocks_[idx].end)
+                        retire(idx);
+                }
+            }
+        }
+
+        void flush() override {
+            std::fill(states_.begin(), states_.end(), BS_UNKNOWN);
+            code_map_ = code_words_;
+            owned_code_map_.clear();
+        }
+
+    protected:
+        /* `code_words` flags every image address covered by at least one block */
+        compiled_program(const memory_value_t* image, const uint8_t* code_words, size_t image_size,
+                         const block_t* blocks, size_t block_count)
+            : image_(image)
+            , code_words_(code_words)
+            , image_size_(image_size)
+            , blocks_(blocks)
+            , block_count_(block_count)
+            , states_(block_count, BS_UNKNOWN)
+            , code_map_(code_words)
+        {}
+
+        /* true if block `idx` may run against the memory of `c` */
+        inline bool enter(computer& c, size_t idx) {
+            if (states_[idx] == BS_UNKNOWN) {
+                const auto& b = blocks_[idx];
+                const auto& memory = memory_of(c);
+                auto matches = true;
+                for (auto addr = b.start; addr < b.end && matches; addr++)
+                    matches = memory[addr] == image_[addr];
+                if (matches)
+                    states_[idx] = BS_VALID;
+                else
+                    retire(idx);
+            }
+            return states_[idx] == BS_VALID;
+        }
+
+        /* writes to addresses covered by a live block have to be left to the interpreter */
+        inline bool is_code(memory_value_t address) const {
+            return size_t(address) < image_size_ && code_map_[size_t(address)];
+        }
+
+    private:
+        enum block_state : uint8_t {
+            BS_UNKNOWN,
+            BS_VALID,
+            BS_RETIRED,
+        };
+
+        inline void retire(size_t idx) {
+            if (states_[idx] == BS_RETIRED)
+                return;
+            states_[idx] = BS_RETIRED;
+            rebuild_code_map();
+        }
+
+        /* the generated map is shared until the first block gets retired */
+        void rebuild_code_map() {
+            owned_code_map_.assign(image_size_, 0);
+            for (size_t idx = 0; idx < block_count_; idx++) {
+                if (states_[idx] == BS_RETIRED)
+                    continue;
+                std::fill(owned_code_map_.begin() + ptrdiff_t(blocks_[idx].start),
+                          owned_code_map_.begin() + ptrdiff_t(blocks_[idx].end), 1);
+            }
+            code_map_ = owned_code_map_.data();
+        }
+
+        const memory_value_t* image_;
+        const uint8_t* code_words_;
+        size_t image_size_;
+        const block_t* blocks_;
+        size_t block_count_;
+        std::vector<block_state> states_{};
+        const uint8_t* code_map_;
+        std::vector<uint8_t> owned_code_map_{};
+    };
+
+    /* defined by the translation unit generated for the day (see aoc_compiled_day() in CMakeLists.txt) */
+    std::unique_ptr<computer::accelerator> make_compiled_program();
+
+    inline void enable_compiled_program(computer& c) {
+        c.set_accelerator(make_compiled_program());
+    }
+}
@@ -0,0 +1,308 @@
+#pragma once
+
+#include "computer.h"
+
+/*
+ * Runs one Intcode program for many independent input sets at once. Memory is kept as one row of
+ * `lanes` values per address, so an instruction whose operands sit at the same address in every lane
+ * (which is what most instructions of a probe-style program look like) is a handful of straight loops
+ * over a row, and those get vectorized. Lanes only run together while they agree on the instruction
+ * pointer: when a jump or a patched opcode sends some of them elsewhere they are split off into a group
+ * of their own, which is then run the same way.
+ */
+
+#if !defined(AOC_BATCH_LANES)
+#if defined(__AVX512F__)
+#define AOC_BATCH_LANES 16
+#elif defined(__AVX2__)
+#define AOC_BATCH_LANES 8
+#else
+#define AOC_BATCH_LANES 4
+#endif
+#endif
+
+namespace aoc {
+    template <size_t lanes = AOC_BATCH_LANES>
+    class batch_computer {
+        static_assert(lanes > 0 && lanes <= 32 && !(lanes & (lanes - 1)));
+
+    public:
+        using value_t = computer::memory_value_t;
+        using inputs_t = std::vector<value_t>;
+        using outputs_t = std::vector<value_t>;
+
+        explicit batch_computer(const computer& image)
+            : image_(image.memory().to_vector())
+        {}
+
+        /* runs the program once per entry of `inputs` and returns what each run printed */
+        std::vector<outputs_t> run(const std::vector<inputs_t>& inputs) {
+            std::vector<outputs_t> ret(inputs.size());
+            for (size_t first = 0; first < inputs.size(); first += lanes) {
+                auto count = std::min(lanes, inputs.size() - first);
+                load(&inputs[first], &ret[first], count);
+                groups_.push_back({mask_t((uint64_t(1) << count) - 1), 0});
+                while (!groups_.empty()) {
+                    auto g = groups_.back();
+                    groups_.pop_back();
+                    run_group(g);
+                }
+            }
+            return ret;
+        }
+
+    private:
+        using mask_t = uint32_t;
+
+        struct alignas(sizeof(value_t) * lanes) row_t {
+            value_t v[lanes];
+        };
+
+        /* lanes which currently share an instruction pointer */
+        struct group_t {
+            mask_t mask;
+            size_t ip;
+        };
+
+        static constexpr const mask_t full_mask = mask_t((uint64_t(1) << lanes) - 1);
+        static constexpr const size_t max_address = size_t(1) << 24;
+
+        void load(const inputs_t* inputs, outputs_t* outputs, size_t count) {
+            if (memory_.size() < image_.size()) {
+                memory_.resize(image_.size());
+                dirty_.resize(image_.size());
+                for (size_t addr = 0; addr < image_.size(); addr++)
+                    std::fill(std::begin(memory_[addr].v), std::end(memory_[addr].v), image_[addr]);
+            }
+            /* only the rows the previous batch wrote have to go back to the image */
+            for (auto addr : dirty_rows_) {
+                auto v = addr < image_.size() ? image_[addr] : 0;
+                std::fill(std::begin(memory_[addr].v), std::end(memory_[addr].v), v);
+                dirty_[addr] = false;
+            }
+            dirty_rows_.clear();
+            for (size_t l = 0; l < lanes; l++) {
+                relbase_[l] = 0;
+                inputs_[l] = l < count ? &inputs[l] : nullptr;
+                next_input_[l] = 0;
+                outputs_[l] = l < count ? &outputs[l] : nullptr;
+            }
+        }
+
+        inline void touch(size_t address) {
+            if (!dirty_[address]) {
+                dirty_[address] = true;
+                dirty_rows_.push_back(address);
+            }
+        }
+
+        inline void ensure(size_t address) {
+            if (address < memory_.size())
+                return;
+            if (address >= max_address) {
+                fmt::print(::stderr, "ADDRESS OUT OF RANGE: {}\n", address);
+                std::abort();
+            }
+            memory_.resize(std::max(address + 1, memory_.size() * 2), row_t{});
+            dirty_.resize(memory_.size());
+        }
+
+        /*
+         * Keeps the lanes of `g` whose `key` matches that of its first lane and moves every other set of
+         * lanes agreeing on it into a group of its own, which starts at `key` if that is a jump target.
+         */
+        template <typename K>
+        inline void split(group_t& g, const K& key, bool key_is_ip) {
+            auto lead = size_t(__builtin_ctz(g.mask));
+            for (mask_t rest = g.mask; rest; ) {
+                auto first = size_t(__builtin_ctz(rest));
+                mask_t same{0};
+                for (size_t l = first; l < lanes; l++) {
+                    if ((rest >> l & 1) && key[l] == key[first])
+                        same |= mask_t(1) << l;
+                }
+                if (first != lead)
+                    groups_.push_back({same, key_is_ip ? size_t(key[first]) : g.ip});
+                else
+                    g.mask = same;
+                rest &= ~same;
+            }
+        }
+
+        /* true if every lane of `row` selected by `on` (all bits set or clear per lane) holds `v` */
+        static inline bool agree(const value_t (&row)[lanes], const value_t (&on)[lanes], value_t v) {
+            value_t diff{0};
+            for (size_t l = 0; l < lanes; l++)
+                diff |= (row[l] ^ v) & on[l];
+            return !diff;
+        }
+
+        void run_group(group_t g) {
+            alignas(sizeof(row_t)) value_t tmp[lanes]{};
+            alignas(sizeof(row_t)) value_t on[lanes]{};
+            /* a parameter address is either the same in all lanes (`at`) or per lane (`addr`) */
+            std::array<bool, 3> uniform{};
+            std::array<size_t, 3> at{};
+            std::array<std::array<size_t, lanes>, 3> addr{};
+
+            auto active = [&g](size_t l) { return g.mask >> l & 1; };
+            auto refresh = [&] {
+                for (size_t l = 0; l < lanes; l++)
+                    on[l] = -value_t(active(l));
+            };
+            refresh();
+            auto relbase_uniform = agree(relbase_, on, relbase_[__builtin_ctz(g.mask)]);
+            auto value = [&](size_t p, size_t l) -> value_t& {
+                return memory_[uniform[p] ? at[p] : addr[p][l]].v[l];
+            };
+
+            while (true) {
+                ensure(g.ip + 3);
+                auto lead = size_t(__builtin_ctz(g.mask));
+                /* a patched opcode can make lanes disagree on the instruction itself */
+                auto op = memory_[g.ip].v[lead];
+                if (!agree(memory_[g.ip].v, on, op)) {
+                    split(g, memory_[g.ip].v, false);
+                    refresh();
+                }
+                auto code = op % 100;
+                auto length = size_t(code == computer::OP_ADD || code == computer::OP_MUL || code == computer::OP_LT ||
+                                     code == computer::OP_EQ ? 4 : code == computer::OP_JNZ || code == computer::OP_JZ ? 3
+                                   : code == computer::OP_IN || code == computer::OP_OUT || code == computer::OP_SRB ? 2 : 1);
+
+                for (size_t p = 0; p + 1 < length; p++) {
+                    auto mode = (op / (p == 0 ? 100 : p == 1 ? 1000 : 10000)) % 10;
+                    auto raw = g.ip + p + 1;
+                    auto rel = mode == computer::AM_RELBASE;
+                    value_t first = mode == computer::AM_IMMEDIATE ? value_t(raw) : memory_[raw].v[lead] + (rel ? relbase_[lead] : 0);
+                    uniform[p] = mode == computer::AM_IMMEDIATE || (agree(memory_[raw].v, on, memory_[raw].v[lead]) && (!rel || relbase_uniform));
+                    value_t highest{first};
+                    if (uniform[p]) {
+                        if (first < 0) {
+                            fmt::print(::stderr, "INVALID ADDRESS {} at IP={}\n", first, g.ip);
+                            std::abort();
+                        }
+                        at[p] = size_t(first);
+                    } else {
+                        for (size_t l = 0; l < lanes; l++) {
+                            if (!on[l])
+                                continue;
+                            auto a = memory_[raw].v[l] + (rel ? relbase_[l] : 0);
+                            if (a < 0) {
+                                fmt::print(::stderr, "INVALID ADDRESS {} at IP={}\n", a, g.ip);
+                                std::abort();
+                            }
+                            addr[p][l] = size_t(a);
+                            highest = std::max(highest, a);
+                        }
+                    }
+                    ensure(size_t(highest));
+                }
+
+                switch (code) {
+                    case computer::OP_ADD:
+                    case computer::OP_MUL:
+                    case computer::OP_LT:
+                    case computer::OP_EQ: {
+                        if (uniform[0] && uniform[1] && uniform[2]) {
+                            const auto& a = memory_[at[0]].v;
+                            const auto& b = memory_[at[1]].v;
+                            auto& d = memory_[at[2]].v;
+                            touch(at[2]);
+                            switch (code) {
+                                case computer::OP_ADD: for (size_t l = 0; l < lanes; l++) tmp[l] = a[l] + b[l]; break;
+                                case computer::OP_MUL: for (size_t l = 0; l < lanes; l++) tmp[l] = a[l] * b[l]; break;
+                                case computer::OP_LT: for (size_t l = 0; l < lanes; l++) tmp[l] = a[l] < b[l]; break;
+                                default: for (size_t l = 0; l < lanes; l++) tmp[l] = a[l] == b[l]; break;
+                            }
+                            for (size_t l = 0; l < lanes; l++)
+                                d[l] = (tmp[l] & on[l]) | (d[l] & ~on[l]);
+                        } else {
+                            for (size_t l = 0; l < lanes; l++) {
+                                if (!on[l])
+                                    continue;
+                                auto a = value(0, l);
+                                auto b = value(1, l);
+                                touch(uniform[2] ? at[2] : addr[2][l]);
+                                value(2, l) = code == computer::OP_ADD ? a + b : code == computer::OP_MUL ? a * b
+                                            : code == computer::OP_LT ? a < b : a == b;
+                            }
+                        }
+                        g.ip += 4;
+                        break;
+                    }
+                    case computer::OP_IN: {
+                        for (size_t l = 0; l < lanes; l++) {
+                            if (!on[l])
+                                continue;
+                            if (next_input_[l] >= inputs_[l]->size()) {
+                                fmt::print(::stderr, "NO INPUT at IP={}\n", g.ip);
+                                std::abort();
+                            }
+                            touch(uniform[0] ? at[0] : addr[0][l]);
+                            value(0, l) = (*inputs_[l])[next_input_[l]++];
+                        }
+                        g.ip += 2;
+                        break;
+                    }
+                    case computer::OP_OUT: {
+                        for (size_t l = 0; l < lanes; l++) {
+                            if (on[l])
+                                outputs_[l]->push_back(value(0, l));
+                        }
+                        g.ip += 2;
+                        break;
+                    }
+                    case computer::OP_JNZ:
+                    case computer::OP_JZ: {
+                        auto jnz = code == computer::OP_JNZ;
+                        if (uniform[0] && uniform[1]) {
+                            const auto& c = memory_[at[0]].v;
+                            const auto& t = memory_[at[1]].v;
+                            for (size_t l = 0; l < lanes; l++)
+                                tmp[l] = (c[l] != 0) == jnz ? t[l] : value_t(g.ip + 3);
+                        } else {
+                            for (size_t l = 0; l < lanes; l++)
+                                tmp[l] = on[l] && (value(0, l) != 0) == jnz ? value(1, l) : value_t(g.ip + 3);
+                        }
+                        auto target = tmp[lead];
+                        if (!agree(tmp, on, target)) {
+                            split(g, tmp, true);
+                            refresh();
+                        }
+                        if (target < 0) {
+                            fmt::print(::stderr, "INVALID JUMP TARGET {} at IP={}\n", target, g.ip);
+                            std::abort();
+                        }
+                        g.ip = size_t(target);
+                        break;
+                    }
+                    case computer::OP_SRB: {
+                        for (size_t l = 0; l < lanes; l++) {
+                            if (on[l])
+                                relbase_[l] += value(0, l);
+                        }
+                        relbase_uniform = agree(relbase_, on, relbase_[lead]);
+                        g.ip += 2;
+                        break;
+                    }
+                    case computer::OP_HLT:
+                        return;
+                    default:
+                        fmt::print(::stderr, "INVALID INSTRUCTION at IP={}: {}\n", g.ip, op);
+                        std::abort();
+                }
+            }
+        }
+
+        std::vector<value_t> image_;
+        std::vector<row_t> memory_{};
+        std::vector<bool> dirty_{};
+        std::vector<size_t> dirty_rows_{};
+        value_t relbase_[lanes]{};
+        std::array<const inputs_t*, lanes> inputs_{};
+        std::array<size_t, lanes> next_input_{};
+        std::array<outputs_t*, lanes> outputs_{};
+        std::vector<group_t> groups_{};
+    };
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+#include "computer.h"
+
+#include <coroutine>
+#include <span>
+
+/*
+ * Intcode programs as C++20 coroutines. A process runs its computer at full speed and only suspends
+ * when it needs a value its input channel does not have yet or when its output channel is full; the
+ * scheduler then resumes whichever process got unblocked. pipeline wires a list of computers into a
+ * chain or a ring of such processes.
+ */
+
+namespace aoc {
+    /* single-threaded run queue of suspended coroutines */
+    class scheduler {
+    public:
+        inline void schedule(std::coroutine_handle<> h) {
+            ready_.push_back(h);
+        }
+
+        void run() {
+            while (!ready_.empty()) {
+                auto h = ready_.front();
+                ready_.pop_front();
+                h.resume();
+            }
+        }
+
+    private:
+        std::deque<std::coroutine_handle<>> ready_{};
+    };
+
+    /* bounded FIFO with (at most) one reading and one writing coroutine on the same scheduler */
+    template <typename T>
+    class channel {
+    public:
+        static constexpr const size_t unbounded = std::numeric_limits<size_t>::max();
+
+        explicit channel(scheduler& sched, size_t capacity = 1)
+            : sched_(sched)
+            , capacity_(std::max<size_t>(1, capacity))
+        {}
+        channel(const channel&) = delete;
+        channel& operator=(const channel&) = delete;
+
+        inline size_t size() const {
+            return values_.size();
+        }
+        inline bool empty() const {
+            return values_.empty();
+        }
+        /* the most recent value pushed, even if it has been read since */
+        inline std::optional<T> last() const {
+            return last_;
+        }
+
+        /* for the host side: never suspends */
+        bool try_push(T v) {
+            if (values_.size() >= capacity_)
+                return false;
+            put(v);
+            return true;
+        }
+        std::optional<T> try_pop() {
+            if (values_.empty())
+                return std::nullopt;
+            return take();
+        }
+
+        auto push(T v) {
+            struct awaiter {
+                channel& ch;
+                T v;
+
+                inline bool await_ready() const noexcept { return ch.values_.size() < ch.capacity_; }
+                inline void await_suspend(std::coroutine_handle<> h) noexcept { ch.writer_ = h; }
+                inline void await_resume() { ch.put(v); }
+            };
+            return awaiter{*this, v};
+        }
+        auto pop() {
+            struct awaiter {
+                channel& ch;
+
+                inline bool await_ready() const noexcept { return !ch.values_.empty(); }
+                inline void await_suspend(std::coroutine_handle<> h) noexcept { ch.reader_ = h; }
+                inline T await_resume() { return ch.take(); }
+            };
+            return awaiter{*this};
+        }
+
+    private:
+        inline void put(T v) {
+            values_.push_back(v);
+            last_ = v;
+            if (reader_)
+                sched_.schedule(std::exchange(reader_, {}));
+        }
+        inline T take() {
+            auto ret = values_.front();
+            values_.pop_front();
+            if (writer_)
+                sched_.schedule(std::exchange(writer_, {}));
+            return ret;
+        }
+
+        scheduler& sched_;
+        size_t capacity_;
+        std::deque<T> values_{};
+        std::optional<T> last_{};
+        std::coroutine_handle<> reader_{};
+        std::coroutine_handle<> writer_{};
+    };
+
+    /* owning handle of a coroutine started with run_process() */
+    class process {
+    public:
+        struct promise_type {
+            inline process get_return_object() { return process(handle_t::from_promise(*this)); }
+            inline std::suspend_always initial_suspend() noexcept { return {}; }
+            inline std::suspend_always final_suspend() noexcept { return {}; }
+            inline void return_void() {}
+            [[noreturn]] inline void unhandled_exception() { std::abort(); }
+        };
+        using handle_t = std::coroutine_handle<promise_type>;
+
+        process(process&& other) noexcept : h_(std::exchange(other.h_, {})) {}
+        process(const process&) = delete;
+        process& operator=(const process&) = delete;
+        ~process() {
+            if (h_)
+                h_.destroy();
+        }
+
+        inline bool done() const {
+            return h_.done();
+        }
+        inline handle_t handle() const {
+            return h_;
+        }
+
+    private:
+        explicit process(handle_t h) : h_(h) {}
+
+        handle_t h_;
+    };
+
+    /* starts suspended; schedule handle() to get it going */
+    inline process run_process(computer& c, channel<computer::memory_value_t>& in, channel<computer::memory_value_t>& out) {
+        while (true) {
+            switch (c.execute_until_blocked(1)) {
+                case computer::BR_HALTED:
+                    co_return;
+                case computer::BR_OUTPUT:
+                    co_await out.push(c.get_output().value());
+                    break;
+                case computer::BR_NEEDS_INPUT:
+                    c.add_input(co_await in.pop());
+                    break;
+            }
+        }
+    }
+
+    /*
+     * Stage i reads from channel i and writes to channel i + 1. In a ring the last stage writes back
+     * into channel 0; in a chain the first and last channels are unbounded and left to the host. The
+     * computers are borrowed and have to outlive the pipeline.
+     */
+    class pipeline {
+    public:
+        using value_t = computer::memory_value_t;
+
+        enum topology {
+            chain,
+            ring,
+        };
+
+        pipeline(std::span<computer> stages, topology shape, size_t capacity = 1)
+            : stages_(stages)
+        {
+            auto count = stages_.size() + (shape == chain ? 1 : 0);
+            for (size_t idx = 0; idx < count; idx++) {
+                auto bounded = shape == ring || (idx && idx + 1 < count);
+                channels_.emplace_back(sched_, bounded ? capacity : channel<value_t>::unbounded);
+            }
+            for (size_t idx = 0; idx < stages_.size(); idx++)
+                processes_.push_back(run_process(stages_[idx], channels_[idx], channels_[(idx + 1) % count]));
+        }
+        pipeline(const pipeline&) = delete;
+        pipeline& operator=(const pipeline&) = delete;
+
+        inline channel<value_t>& input() {
+            return channels_.front();
+        }
+        inline channel<value_t>& output() {
+            return channels_[stages_.size() % channels_.size()];
+        }
+
+        /* returns true once every stage halted, false if the remaining ones wait for input */
+        bool run() {
+            if (!started_) {
+                for (const auto& p : processes_)
+                    sched_.schedule(p.handle());
+                started_ = true;
+            }
+            sched_.run();
+            return std::all_of(processes_.begin(), processes_.end(), [](const process& p) { return p.done(); });
+        }
+
+    private:
+        scheduler sched_{};
+        std::span<computer> stages_;
+        std::deque<channel<value_t>> channels_{};
+        std::vector<process> processes_{};
+        bool started_{false};
+    };
+}
@@ -0,0 +1,689 @@
+#pragma once
+
+#include "computer.h"
+
+/*
+ * Register IR back end for aoc::computer, a portable middle ground between the interpreter and the JIT.
+ * Once its entry point has been reached `hot_threshold` times, a region of ADD/MUL/LT/EQ/SRB and jumps
+ * (jumps which are always taken are followed) is lowered to a three-address IR over virtual registers
+ * and optimized before it is run by a small interpreter of its own:
+ *  - immediates live in preloaded registers, operations on known values are folded and jumps on known
+ *    conditions either become unconditional or disappear
+ *  - cells at constant addresses are kept in registers and only written back when the region leaves,
+ *    loops or goes through a computed address, so a value stored twice is only written once
+ *  - values nothing reads any more are not computed
+ * Parameter words the program writes are read while the region runs instead of being folded into it.
+ * Writing any other word of a region (from the interpreter or from a region) drops it, and it is lowered
+ * again with that word treated as written the next time it is entered.
+ */
+
+namespace aoc {
+    class computer_ir : public computer::accelerator {
+    public:
+        using memory_value_t = computer::memory_value_t;
+
+        static constexpr const uint32_t default_hot_threshold = 8;
+        static constexpr const size_t max_region_instructions = 256;
+
+        explicit computer_ir(uint32_t hot_threshold = default_hot_threshold)
+            : hot_threshold_(hot_threshold)
+        {}
+
+        std::unique_ptr<computer::accelerator> clone() const override {
+            return std::make_unique<computer_ir>(hot_threshold_);
+        }
+
+        bool handles(computer::instruction_code code) const override {
+            switch (code) {
+                case computer::OP_ADD: [[fallthrough]];
+                case computer::OP_MUL: [[fallthrough]];
+                case computer::OP_JNZ: [[fallthrough]];
+                case computer::OP_JZ: [[fallthrough]];
+                case computer::OP_LT: [[fallthrough]];
+                case computer::OP_EQ: [[fallthrough]];
+                case computer::OP_SRB: return true;
+                default: return false;
+            }
+        }
+
+        void run(computer& c) override {
+            auto& ip = register_ref(c, computer::RC_IP);
+            auto& relbase = register_ref(c, computer::RC_RELBASE);
+
+            while (ip >= 0 && size_t(ip) < memory_of(c).size()) {
+                auto addr = size_t(ip);
+                if (entries_.size() <= addr)
+                    entries_.resize(addr + 1);
+                auto& entry = entries_[addr];
+                if (!entry.region) {
+                    if (entry.hits == uncompilable || ++entry.hits < hot_threshold_)
+                        return;
+                    entry.region = lower(c, addr);
+                    if (!entry.region) {
+                        entry.hits = uncompilable;
+                        return;
+                    }
+                }
+                execute(c, *entry.region, ip, relbase);
+
+                /* regions are only dropped once none of them is running */
+                for (auto written : pending_)
+                    invalidate(written, 1);
+                pending_.clear();
+            }
+        }
+
+        void invalidate(size_t address, size_t count) override {
+            auto last = std::min(owners_.size(), address + count);
+            for (auto addr = address; addr < last; addr++) {
+                if (owners_[addr].empty())
+                    continue;
+                written_code_.insert(addr);
+                /* releasing takes each entry off the list being walked */
+                while (!owners_[addr].empty())
+                    release(owners_[addr].back());
+            }
+        }
+
+        void flush() override {
+            entries_.clear();
+            owners_.clear();
+            pending_.clear();
+        }
+
+    private:
+        using memory_t = computer::memory_t;
+
+        enum ir_code : uint8_t {
+            IR_LOAD,            /* dst = memory[k] */
+            IR_LOAD_REL,        /* dst = memory[relbase + k] */
+            IR_LOAD_IND,        /* dst = memory[a] */
+            IR_LOAD_IND_REL,    /* dst = memory[relbase + a] */
+            IR_STORE,           /* memory[k] = a */
+            IR_STORE_REL,       /* memory[relbase + k] = a, leaving for dst if that hit a lowered word */
+            IR_STORE_IND,       /* memory[b] = a, likewise */
+            IR_STORE_IND_REL,   /* memory[relbase + b] = a, likewise */
+            IR_ADD,
+            IR_MUL,
+            IR_LT,
+            IR_EQ,
+            IR_SRB,             /* relbase += a */
+            IR_EXIT_NZ,         /* leave for b if a != 0 */
+            IR_EXIT_Z,          /* leave for b if a == 0 */
+            IR_EXIT,            /* leave for b */
+            IR_LOOP_NZ,         /* back to the start if a != 0 */
+            IR_LOOP_Z,          /* back to the start if a == 0 */
+            IR_LOOP,
+        };
+
+        /* the cells exits write back are a slice [k, k + dst) of region_t::writebacks */
+        struct op_t {
+            ir_code code;
+            uint32_t dst{0};
+            uint32_t a{0};
+            uint32_t b{0};
+            memory_value_t k{0};
+        };
+
+        struct writeback_t {
+            memory_value_t address;
+            uint32_t reg;
+        };
+
+        struct region_t {
+            std::vector<op_t> ops{};
+            std::vector<writeback_t> writebacks{};
+            /* constants are loaded once, everything else is scratch */
+            std::vector<memory_value_t> registers{};
+            /* the words the region was lowered from, sorted */
+            std::vector<size_t> words{};
+        };
+
+        static constexpr const uint32_t uncompilable = std::numeric_limits<uint32_t>::max();
+
+        struct entry_t {
+            std::unique_ptr<region_t> region{};
+            uint32_t hits{0};
+        };
+
+        struct instruction_t {
+            size_t address;
+            computer::instruction_code code;
+            size_t length;
+            std::array<computer::addressing_mode, 3> modes{};
+            std::array<memory_value_t, 3> words{};
+            /* read while the region runs since something writes it */
+            std::array<bool, 3> written{};
+
+            inline bool known(size_t p) const {
+                return modes[p] == computer::AM_IMMEDIATE && !written[p];
+            }
+        };
+
+        static inline bool promotable(memory_value_t address) {
+            return address >= 0 && address < memory_t::max_address;
+        }
+
+        static inline bool defines(const op_t& op) {
+            return op.code <= IR_LOAD_IND_REL || (op.code >= IR_ADD && op.code <= IR_EQ);
+        }
+
+        template <typename F>
+        static inline void for_each_use(op_t& op, const F& f) {
+            switch (op.code) {
+                case IR_LOAD: [[fallthrough]];
+                case IR_LOAD_REL: [[fallthrough]];
+                case IR_LOOP: break;
+                case IR_LOAD_IND: [[fallthrough]];
+                case IR_LOAD_IND_REL: [[fallthrough]];
+                case IR_STORE: [[fallthrough]];
+                case IR_SRB: [[fallthrough]];
+                case IR_LOOP_NZ: [[fallthrough]];
+                case IR_LOOP_Z: f(op.a); break;
+                case IR_STORE_REL: f(op.a); f(op.dst); break;
+                case IR_STORE_IND: [[fallthrough]];
+                case IR_STORE_IND_REL: f(op.a); f(op.b); f(op.dst); break;
+                case IR_EXIT: f(op.b); break;
+                default: f(op.a); f(op.b); break;
+            }
+        }
+
+        static inline bool is_exit(ir_code code) {
+            return code >= IR_EXIT_NZ;
+        }
+
+        /* a region while it is being lowered and optimized, exits carry an index into `writebacks` in `k` */
+        struct function_t {
+            std::vector<op_t> ops{};
+            std::vector<std::vector<writeback_t>> writebacks{};
+            std::vector<std::optional<memory_value_t>> values{};
+            std::vector<uint32_t> alias{};
+            /* regions are short, so the lookups below are linear */
+            std::vector<std::pair<memory_value_t, uint32_t>> constants{};
+
+            uint32_t temp() {
+                values.emplace_back();
+                alias.push_back(uint32_t(alias.size()));
+                return alias.back();
+            }
+            uint32_t constant(memory_value_t v) {
+                for (const auto& [value, reg] : constants) {
+                    if (value == v)
+                        return reg;
+                }
+                constants.emplace_back(v, temp());
+                values.back() = v;
+                return constants.back().second;
+            }
+            inline uint32_t resolve(uint32_t reg) const {
+                while (alias[reg] != reg)
+                    reg = alias[reg];
+                return reg;
+            }
+            inline const std::optional<memory_value_t>& value(uint32_t reg) const {
+                return values[reg];
+            }
+
+            uint32_t emit(ir_code code, uint32_t a = 0, uint32_t b = 0, memory_value_t k = 0) {
+                op_t op{code, 0, a, b, k};
+                if (defines(op))
+                    op.dst = temp();
+                if (is_exit(code)) {
+                    op.k = memory_value_t(writebacks.size());
+                    writebacks.emplace_back();
+                }
+                ops.push_back(op);
+                return op.dst;
+            }
+
+            void resolve_uses(op_t& op) {
+                for_each_use(op, [this](uint32_t& reg) { reg = resolve(reg); });
+                if (is_exit(op.code)) {
+                    for (auto& wb : writebacks[size_t(op.k)])
+                        wb.reg = resolve(wb.reg);
+                }
+            }
+
+            /* folds operations on known values and jumps on known conditions */
+            void fold() {
+                std::vector<op_t> out{};
+                for (auto op : ops) {
+                    resolve_uses(op);
+                    /* copies, constant() may grow `values` */
+                    std::optional<memory_value_t> a{}, b{};
+                    if (op.a < values.size())
+                        a = value(op.a);
+                    if (op.b < values.size())
+                        b = value(op.b);
+                    switch (op.code) {
+                        case IR_ADD: [[fallthrough]];
+                        case IR_MUL: [[fallthrough]];
+                        case IR_LT: [[fallthrough]];
+                        case IR_EQ: {
+                            std::optional<uint32_t> same{};
+                            if (a && b)
+                                same = constant(op.code == IR_ADD ? *a + *b : op.code == IR_MUL ? *a * *b
+                                              : op.code == IR_LT ? *a < *b : *a == *b);
+                            else if (op.code == IR_ADD && (a == 0 || b == 0))
+                                same = a == 0 ? op.b : op.a;
+                            else if (op.code == IR_MUL && (a == 1 || b == 1))
+                                same = a == 1 ? op.b : op.a;
+                            else if (op.code == IR_MUL && (a == 0 || b == 0))
+                                same = constant(0);
+                            else if ((op.code == IR_LT || op.code == IR_EQ) && op.a == op.b)
+                                same = constant(op.code == IR_EQ);
+                            if (same) {
+                                alias[op.dst] = *same;
+                                continue;
+                            }
+                            break;
+                        }
+                        case IR_SRB: {
+                            if (a == 0)
+                                continue;
+                            break;
+                        }
+                        case IR_EXIT_NZ: [[fallthrough]];
+                        case IR_EXIT_Z: [[fallthrough]];
+                        case IR_LOOP_NZ: [[fallthrough]];
+                        case IR_LOOP_Z: {
+                            if (!a)
+                                break;
+                            auto nz = op.code == IR_EXIT_NZ || op.code == IR_LOOP_NZ;
+                            if ((*a != 0) != nz)
+                                continue;
+                            /* always taken: nothing after it runs */
+                            op.code = op.code == IR_EXIT_NZ || op.code == IR_EXIT_Z ? IR_EXIT : IR_LOOP;
+                            out.push_back(op);
+                            ops = std::move(out);
+                            return;
+                        }
+                        default: break;
+                    }
+                    out.push_back(op);
+                }
+                ops = std::move(out);
+            }
+
+            /*
+             * Keeps cells at constant addresses in registers. A cell is written back when the region leaves
+             * or loops and before any access through a computed address, which may hit it; a computed store
+             * also forgets every cell.
+             */
+            void promote() {
+                struct cell_t {
+                    memory_value_t address;
+                    uint32_t reg;
+                    bool dirty;
+                };
+                std::vector<cell_t> cells{};
+                std::vector<op_t> out{};
+                auto find = [&cells](memory_value_t address) {
+                    return std::find_if(cells.begin(), cells.end(), [address](const cell_t& cell) { return cell.address == address; });
+                };
+                auto write_back = [&] {
+                    for (auto& cell : cells) {
+                        if (cell.dirty)
+                            out.push_back({IR_STORE, 0, cell.reg, 0, cell.address});
+                        cell.dirty = false;
+                    }
+                };
+                for (auto op : ops) {
+                    resolve_uses(op);
+                    switch (op.code) {
+                        case IR_LOAD: {
+                            if (!promotable(op.k))
+                                break;
+                            if (auto it = find(op.k); it != cells.end()) {
+                                alias[op.dst] = it->reg;
+                                continue;
+                            }
+                            cells.push_back({op.k, op.dst, false});
+                            break;
+                        }
+                        case IR_STORE: {
+                            if (!promotable(op.k))
+                                break;
+                            if (auto it = find(op.k); it == cells.end())
+                                cells.push_back({op.k, op.a, true});
+                            else if (it->reg != op.a)
+                                *it = {op.k, op.a, true};
+                            continue;
+                        }
+                        case IR_LOAD_REL: [[fallthrough]];
+                        case IR_LOAD_IND: [[fallthrough]];
+                        case IR_LOAD_IND_REL: {
+                            write_back();
+                            break;
+                        }
+                        case IR_STORE_REL: [[fallthrough]];
+                        case IR_STORE_IND: [[fallthrough]];
+                        case IR_STORE_IND_REL: {
+                            write_back();
+                            cells.clear();
+                            break;
+                        }
+                        default: {
+                            if (!is_exit(op.code))
+                                break;
+                            auto& wbs = writebacks[size_t(op.k)];
+                            for (const auto& cell : cells) {
+                                if (cell.dirty)
+                                    wbs.push_back({cell.address, cell.reg});
+                            }
+                            break;
+                        }
+                    }
+                    out.push_back(op);
+                }
+                ops = std::move(out);
+            }
+
+            /* drops computations whose result is never used and loads which cannot fault */
+            void remove_dead() {
+                std::vector<bool> live(values.size());
+                std::vector<op_t> out{};
+                for (auto it = ops.rbegin(); it != ops.rend(); ++it) {
+                    auto op = *it;
+                    if (defines(op)) {
+                        auto pure = op.code == IR_LOAD ? promotable(op.k) : op.code >= IR_ADD;
+                        if (!live[op.dst] && pure)
+                            continue;
+                        live[op.dst] = false;
+                    }
+                    for_each_use(op, [&live](uint32_t& reg) { live[reg] = true; });
+                    if (is_exit(op.code)) {
+                        for (const auto& wb : writebacks[size_t(op.k)])
+                            live[wb.reg] = true;
+                    }
+                    out.push_back(op);
+                }
+                ops.assign(out.rbegin(), out.rend());
+            }
+
+            /* numbers the registers which are still used densely and lays out the writebacks */
+            void finalize(region_t& r) {
+                std::vector<uint32_t> number(values.size(), std::numeric_limits<uint32_t>::max());
+                auto renumber = [&](uint32_t& reg) {
+                    if (number[reg] == std::numeric_limits<uint32_t>::max()) {
+                        number[reg] = uint32_t(r.registers.size());
+                        r.registers.push_back(values[reg].value_or(0));
+                    }
+                    reg = number[reg];
+                };
+                for (auto op : ops) {
+                    if (defines(op))
+                        renumber(op.dst);
+                    for_each_use(op, renumber);
+                    if (is_exit(op.code)) {
+                        const auto& wbs = writebacks[size_t(op.k)];
+                        op.k = memory_value_t(r.writebacks.size());
+                        op.dst = uint32_t(wbs.size());
+                        for (auto wb : wbs) {
+                            renumber(wb.reg);
+                            r.writebacks.push_back(wb);
+                        }
+                    }
+                    r.ops.push_back(op);
+                }
+            }
+        };
+
+        /*
+         * Collects the instructions of the region starting at `start`, stopping at `limit` of them. Returns
+         * where execution continues after the last one, or nothing if that is an always taken jump to a
+         * computed target.
+         */
+        std::optional<memory_value_t> discover(computer& c, size_t start, size_t limit, const std::vector<size_t>& patched,
+                                               std::vector<instruction_t>& code) const {
+            const auto& memory = memory_of(c);
+            auto seen = [&code](size_t addr) {
+                return std::any_of(code.begin(), code.end(), [addr](const instruction_t& in) { return in.address == addr; });
+            };
+            code.clear();
+
+            size_t addr{start};
+            while (code.size() < limit && !seen(addr) && !written_code_.count(addr)) {
+                auto raw = memory.read(memory_value_t(addr));
+                if (raw < 0)
+                    break;
+                auto op = computer::instruction_code(raw % 100);
+                if (!handles(op))
+                    break;
+
+                instruction_t in{addr, op, op == computer::OP_SRB ? 2u : op == computer::OP_JNZ || op == computer::OP_JZ ? 3u : 4u};
+                if (addr + in.length > memory.size())
+                    break;
+                auto modes = raw / 100;
+                bool ok{true};
+                for (size_t p = 0; p + 1 < in.length; p++) {
+                    in.modes[p] = computer::addressing_mode(modes % 10);
+                    modes /= 10;
+                    in.words[p] = memory.read(memory_value_t(addr + 1 + p));
+                    in.written[p] = std::find(patched.begin(), patched.end(), addr + 1 + p) != patched.end() ||
+                                    written_code_.count(addr + 1 + p);
+                    ok = ok && in.modes[p] < computer::AM_MAX_;
+                }
+                if (!ok || (in.length == 4 && in.modes[2] == computer::AM_IMMEDIATE))
+                    break;
+
+                code.push_back(in);
+                if ((op == computer::OP_JNZ || op == computer::OP_JZ) && in.known(0) && (in.words[0] != 0) == (op == computer::OP_JNZ)) {
+                    if (!in.known(1))
+                        return std::nullopt;
+                    addr = size_t(in.words[1]);
+                    if (in.words[1] < 0)
+                        return in.words[1];
+                    continue;
+                }
+                addr += in.length;
+            }
+            return memory_value_t(addr);
+        }
+
+        /*
+         * Looks for stores of the region to constant addresses among its own words. A written parameter
+         * has to be read at run time and a written opcode ends the region in front of both instructions.
+         */
+        static bool find_self_writes(const std::vector<instruction_t>& code, std::vector<size_t>& patched, size_t& limit) {
+            bool changed{false};
+            for (size_t idx = 0; idx < code.size(); idx++) {
+                const auto& in = code[idx];
+                if (in.length != 4 || in.modes[2] != computer::AM_POSITION || in.written[2] || in.words[2] < 0)
+                    continue;
+                auto target = size_t(in.words[2]);
+                for (size_t other = 0; other < code.size(); other++) {
+                    auto offset = target - code[other].address;
+                    if (target < code[other].address || offset >= code[other].length || (offset && code[other].written[offset - 1]))
+                        continue;
+                    if (offset)
+                        patched.push_back(target);
+                    else
+                        limit = std::min({limit, idx, other});
+                    changed = true;
+                }
+            }
+            return changed;
+        }
+
+        std::unique_ptr<region_t> lower(computer& c, size_t start) {
+            std::vector<instruction_t> code{};
+            std::vector<size_t> patched{};
+            size_t limit{max_region_instructions};
+            auto end = discover(c, start, limit, patched, code);
+            while (find_self_writes(code, patched, limit))
+                end = discover(c, start, limit, patched, code);
+            if (code.empty())
+                return nullptr;
+
+            function_t f{};
+            auto word = [&f](const instruction_t& in, size_t p) {
+                return in.written[p] ? f.emit(IR_LOAD, 0, 0, memory_value_t(in.address + 1 + p)) : f.constant(in.words[p]);
+            };
+            auto load = [&](const instruction_t& in, size_t p) {
+                switch (in.modes[p]) {
+                    case computer::AM_IMMEDIATE: return word(in, p);
+                    case computer::AM_POSITION: return in.written[p] ? f.emit(IR_LOAD_IND, word(in, p)) : f.emit(IR_LOAD, 0, 0, in.words[p]);
+                    default: return in.written[p] ? f.emit(IR_LOAD_IND_REL, word(in, p)) : f.emit(IR_LOAD_REL, 0, 0, in.words[p]);
+                }
+            };
+            auto store = [&](const instruction_t& in, size_t p, uint32_t value) {
+                if (in.modes[p] == computer::AM_POSITION && !in.written[p]) {
+                    f.emit(IR_STORE, value, 0, in.words[p]);
+                    return;
+                }
+                if (in.written[p])
+                    f.emit(in.modes[p] == computer::AM_POSITION ? IR_STORE_IND : IR_STORE_IND_REL, value, word(in, p));
+                else
+                    f.emit(IR_STORE_REL, value, 0, in.words[p]);
+                /* where to leave if the store hit this region */
+                f.ops.back().dst = f.constant(memory_value_t(in.address + in.length));
+            };
+
+            for (size_t idx = 0; idx < code.size(); idx++) {
+                const auto& in = code[idx];
+                switch (in.code) {
+                    case computer::OP_ADD: [[fallthrough]];
+                    case computer::OP_MUL: [[fallthrough]];
+                    case computer::OP_LT: [[fallthrough]];
+                    case computer::OP_EQ: {
+                        auto in1 = load(in, 0);
+                        auto in2 = load(in, 1);
+                        auto op = in.code == computer::OP_ADD ? IR_ADD : in.code == computer::OP_MUL ? IR_MUL
+                                : in.code == computer::OP_LT ? IR_LT : IR_EQ;
+                        store(in, 2, f.emit(op, in1, in2));
+                        break;
+                    }
+                    case computer::OP_SRB: {
+                        f.emit(IR_SRB, load(in, 0));
+                        break;
+                    }
+                    default: {
+                        auto nz = in.code == computer::OP_JNZ;
+                        if (in.known(0)) {
+                            /* a jump which is always taken is followed by discover() unless it ends the region */
+                            if ((in.words[0] != 0) == nz && idx + 1 == code.size() && !end)
+                                f.emit(IR_EXIT, 0, load(in, 1));
+                            break;
+                        }
+                        auto condition = load(in, 0);
+                        if (in.known(1) && size_t(in.words[1]) == start && in.words[1] >= 0)
+                            f.emit(nz ? IR_LOOP_NZ : IR_LOOP_Z, condition);
+                        else
+                            f.emit(nz ? IR_EXIT_NZ : IR_EXIT_Z, condition, load(in, 1));
+                        break;
+                    }
+                }
+            }
+            if (end && *end == memory_value_t(start))
+                f.emit(IR_LOOP);
+            else if (end)
+                f.emit(IR_EXIT, 0, f.constant(*end));
+
+            f.fold();
+            f.promote();
+            f.fold();
+            f.remove_dead();
+
+            auto r = std::make_unique<region_t>();
+            f.finalize(*r);
+            for (const auto& in : code) {
+                r->words.push_back(in.address);
+                for (size_t p = 0; p + 1 < in.length; p++) {
+                    if (!in.written[p])
+                        r->words.push_back(in.address + 1 + p);
+                }
+            }
+            std::sort(r->words.begin(), r->words.end());
+            r->words.erase(std::unique(r->words.begin(), r->words.end()), r->words.end());
+            if (owners_.size() <= r->words.back())
+                owners_.resize(r->words.back() + 1);
+            for (auto addr : r->words)
+                owners_[addr].push_back(start);
+            return r;
+        }
+
+        void release(size_t start) {
+            auto& entry = entries_[start];
+            for (auto addr : entry.region->words) {
+                auto& owners = owners_[addr];
+                owners.erase(std::find(owners.begin(), owners.end(), start));
+            }
+            entry.region.reset();
+        }
+
+        /* true if the store hit a word some region was lowered from */
+        inline bool store(computer& c, memory_value_t address, memory_value_t value) {
+            memory_of(c).write(address, value);
+            drop_decoded(c, size_t(address));
+            if (size_t(address) >= owners_.size() || owners_[size_t(address)].empty())
+                return false;
+            pending_.push_back(size_t(address));
+            return true;
+        }
+
+        inline void write_back(computer& c, const region_t& r, const op_t& op, const memory_value_t* regs) {
+            for (auto wb = r.writebacks.data() + op.k, last = wb + op.dst; wb < last; wb++)
+                store(c, wb->address, regs[wb->reg]);
+        }
+
+        void execute(computer& c, region_t& r, memory_value_t& ip, memory_value_t& relbase) {
+            const auto& memory = memory_of(c);
+            const auto* ops = r.ops.data();
+            auto* regs = r.registers.data();
+            auto rb = relbase;
+
+            for (size_t pc = 0;;) {
+                const auto& op = ops[pc++];
+                switch (op.code) {
+                    case IR_LOAD: regs[op.dst] = memory.read(op.k); break;
+                    case IR_LOAD_REL: regs[op.dst] = memory.read(rb + op.k); break;
+                    case IR_LOAD_IND: regs[op.dst] = memory.read(regs[op.a]); break;
+                    case IR_LOAD_IND_REL: regs[op.dst] = memory.read(rb + regs[op.a]); break;
+                    case IR_STORE: store(c, op.k, regs[op.a]); break;
+                    case IR_STORE_REL: if (store(c, rb + op.k, regs[op.a])) goto wrote; break;
+                    case IR_STORE_IND: if (store(c, regs[op.b], regs[op.a])) goto wrote; break;
+                    case IR_STORE_IND_REL: if (store(c, rb + regs[op.b], regs[op.a])) goto wrote; break;
+                    case IR_ADD: regs[op.dst] = regs[op.a] + regs[op.b]; break;
+                    case IR_MUL: regs[op.dst] = regs[op.a] * regs[op.b]; break;
+                    case IR_LT: regs[op.dst] = regs[op.a] < regs[op.b]; break;
+                    case IR_EQ: regs[op.dst] = regs[op.a] == regs[op.b]; break;
+                    case IR_SRB: rb += regs[op.a]; break;
+                    case IR_EXIT_NZ: if (!regs[op.a]) break; goto leave;
+                    case IR_EXIT_Z: if (regs[op.a]) break; goto leave;
+                    case IR_EXIT: goto leave;
+                    case IR_LOOP_NZ: if (!regs[op.a]) break; goto loop;
+                    case IR_LOOP_Z: if (regs[op.a]) break; goto loop;
+                    case IR_LOOP: goto loop;
+                }
+                continue;
+            leave:
+                write_back(c, r, op, regs);
+                ip = regs[op.b];
+                relbase = rb;
+                return;
+            loop:
+                write_back(c, r, op, regs);
+                pc = 0;
+                continue;
+                /* cells were written back before any store which can get here */
+            wrote:
+                ip = regs[op.dst];
+                relbase = rb;
+                return;
+            }
+        }
+
+        uint32_t hot_threshold_;
+        std::vector<entry_t> entries_{};
+        /* entry points of the regions lowered from each word */
+        std::vector<std::vector<size_t>> owners_{};
+        std::unordered_set<size_t> written_code_{};
+        std::vector<size_t> pending_{};
+    };
+
+    /* runs the hot parts of `c` through computer_ir instead of the interpreter */
+    inline void enable_ir(computer& c, uint32_t hot_threshold = computer_ir::default_hot_threshold) {
+        c.set_accelerator(std::make_unique<computer_ir>(hot_threshold));
+    }
+}
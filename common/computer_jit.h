@@ -0,0 +1,609 @@
+#pragma once
+
+#include "computer.h"
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define AOC_COMPUTER_JIT_AVAILABLE 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define AOC_COMPUTER_JIT_AVAILABLE 0
+#endif
+
+/*
+ * Basic block JIT for aoc::computer. Blocks of ADD/MUL/LT/EQ/SRB ending in a JNZ/JZ are translated to
+ * x86-64 once their entry point has been reached `hot_threshold` times. Anything else (IN, OUT, HLT,
+ * unknown opcodes, out of range accesses and writes into translated code) makes the native code return
+ * to the interpreter with the VM state exactly as it was before the offending instruction.
+ */
+
+namespace aoc {
+#if AOC_COMPUTER_JIT_AVAILABLE
+    namespace detail {
+        class x86_64_assembler {
+        public:
+            enum reg : uint8_t {
+                RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+                R8, R9, R10, R11, R12, R13, R14, R15,
+            };
+
+            enum condition : uint8_t {
+                CC_AE = 0x3,
+                CC_E  = 0x4,
+                CC_NE = 0x5,
+                CC_BE = 0x6,
+                CC_L  = 0xc,
+            };
+
+            /* [base + disp32] or [base + index * scale]; base must not be RSP/R12 or RBP/R13 */
+            struct mem {
+                reg base;
+                std::optional<reg> index{};
+                uint8_t scale{1};
+                int32_t disp{0};
+            };
+
+            inline const std::vector<uint8_t>& code() const {
+                return code_;
+            }
+            inline size_t size() const {
+                return code_.size();
+            }
+
+            inline void mov(reg dst, int64_t imm) {
+                rex(true, 0, 0, dst);
+                byte(uint8_t(0xb8 + (dst & 7)));
+                raw(imm);
+            }
+            inline void mov(reg dst, reg src) {
+                rr(0x89, src, dst);
+            }
+            inline void mov(reg dst, const mem& src) {
+                rm({0x8b}, true, dst, src);
+            }
+            inline void mov(const mem& dst, reg src) {
+                rm({0x89}, true, src, dst);
+            }
+            inline void mov(const mem& dst, int32_t imm) {
+                rm({0xc7}, true, 0, dst);
+                raw(imm);
+            }
+            inline void movzx_byte(reg dst, const mem& src) {
+                rm({0x0f, 0xb6}, false, dst, src);
+            }
+            inline void lea(reg dst, reg base, int32_t disp) {
+                rm({0x8d}, true, dst, mem{base, {}, 1, disp});
+            }
+            inline void add(reg dst, reg src) {
+                rr(0x01, src, dst);
+            }
+            inline void imul(reg dst, reg src) {
+                rex(true, dst, 0, src);
+                byte(0x0f);
+                byte(0xaf);
+                byte(modrm(3, dst, src));
+            }
+            inline void cmp(reg lhs, reg rhs) {
+                rr(0x39, rhs, lhs);
+            }
+            inline void cmp(reg lhs, const mem& rhs) {
+                rm({0x3b}, true, lhs, rhs);
+            }
+            inline void cmp(const mem& lhs, int32_t imm) {
+                rm({0x81}, true, 7, lhs);
+                raw(imm);
+            }
+            inline void and_(reg dst, int32_t imm) {
+                rex(true, 0, 0, dst);
+                byte(0x81);
+                byte(modrm(3, 4, dst));
+                raw(imm);
+            }
+            inline void test(reg lhs, reg rhs) {
+                rr(0x85, rhs, lhs);
+            }
+            inline void shl(reg dst, uint8_t count) {
+                rex(true, 0, 0, dst);
+                byte(0xc1);
+                byte(modrm(3, 4, dst));
+                byte(count);
+            }
+            inline void shr(reg dst, uint8_t count) {
+                rex(true, 0, 0, dst);
+                byte(0xc1);
+                byte(modrm(3, 5, dst));
+                byte(count);
+            }
+            /* dst = cc ? 1 : 0, dst must be RAX */
+            inline void set_rax(condition cc) {
+                byte(0x0f);
+                byte(uint8_t(0x90 | cc));
+                byte(0xc0);
+                byte(0x0f);
+                byte(0xb6);
+                byte(0xc0);
+            }
+            inline void ret() {
+                byte(0xc3);
+            }
+
+            /* conditional jump with a rel32 to be patched by bind(), returns the patch offset */
+            inline size_t jcc(condition cc) {
+                byte(0x0f);
+                byte(uint8_t(0x80 | cc));
+                raw(int32_t(0));
+                return code_.size() - 4;
+            }
+            inline void bind(size_t patch, size_t target) {
+                auto rel = int32_t(int64_t(target) - int64_t(patch + 4));
+                std::memcpy(code_.data() + patch, &rel, sizeof(rel));
+            }
+
+        private:
+            inline void byte(uint8_t b) {
+                code_.push_back(b);
+            }
+            template <typename T>
+            inline void raw(T v) {
+                uint8_t buff[sizeof(T)];
+                std::memcpy(buff, &v, sizeof(T));
+                code_.insert(code_.end(), std::begin(buff), std::end(buff));
+            }
+            static inline uint8_t modrm(uint8_t mod, uint8_t reg, uint8_t rm) {
+                return uint8_t((mod << 6) | ((reg & 7) << 3) | (rm & 7));
+            }
+            inline void rex(bool w, uint8_t r, uint8_t x, uint8_t b) {
+                uint8_t v = uint8_t(0x40 | (w ? 8 : 0) | ((r >> 3) << 2) | ((x >> 3) << 1) | (b >> 3));
+                if (v != 0x40)
+                    byte(v);
+            }
+            inline void rr(uint8_t op, uint8_t reg, uint8_t rm) {
+                rex(true, reg, 0, rm);
+                byte(op);
+                byte(modrm(3, reg, rm));
+            }
+            inline void rm(std::initializer_list<uint8_t> op, bool w, uint8_t reg, const mem& m) {
+                assert((m.base & 7) != RSP && (m.base & 7) != RBP);
+                if (m.index) {
+                    rex(w, reg, *m.index, m.base);
+                    for (auto b : op) byte(b);
+                    byte(modrm(0, reg, 4));
+                    uint8_t ss = m.scale == 8 ? 3 : m.scale == 4 ? 2 : m.scale == 2 ? 1 : 0;
+                    byte(uint8_t((ss << 6) | ((*m.index & 7) << 3) | (m.base & 7)));
+                } else {
+                    rex(w, reg, 0, m.base);
+                    for (auto b : op) byte(b);
+                    byte(modrm(2, reg, m.base));
+                    raw(m.disp);
+                }
+            }
+
+            std::vector<uint8_t> code_{};
+        };
+
+        /* append-only executable memory, kept W^X by flipping protections around every write */
+        class executable_buffer {
+        public:
+            static constexpr const size_t chunk_size = 256 * 1024;
+
+            executable_buffer() = default;
+            executable_buffer(const executable_buffer&) = delete;
+            executable_buffer& operator=(const executable_buffer&) = delete;
+            ~executable_buffer() {
+                for (auto chunk : chunks_)
+                    munmap(chunk, chunk_size);
+            }
+
+            const void* append(const std::vector<uint8_t>& code) {
+                if (code.size() > chunk_size)
+                    return nullptr;
+                if (chunks_.empty() || used_ + code.size() > chunk_size) {
+                    if (current_ + 1 < chunks_.size()) {
+                        current_ += 1;
+                    } else {
+                        void* chunk = mmap(nullptr, chunk_size, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                        if (chunk == MAP_FAILED)
+                            return nullptr;
+                        chunks_.push_back(static_cast<uint8_t*>(chunk));
+                        current_ = chunks_.size() - 1;
+                    }
+                    used_ = 0;
+                }
+                auto chunk = chunks_[current_];
+                if (mprotect(chunk, chunk_size, PROT_READ | PROT_WRITE))
+                    return nullptr;
+                std::memcpy(chunk + used_, code.data(), code.size());
+                if (mprotect(chunk, chunk_size, PROT_READ | PROT_EXEC))
+                    std::abort();
+                auto ret = chunk + used_;
+                used_ += (code.size() + 15) & ~size_t(15);
+                return ret;
+            }
+
+            /* forget everything that was emitted, the memory is reused */
+            void reset() {
+                current_ = 0;
+                used_ = 0;
+            }
+
+        private:
+            std::vector<uint8_t*> chunks_{};
+            size_t current_{0};
+            size_t used_{0};
+        };
+    }
+
+    class computer_jit : public computer::accelerator {
+    public:
+        using memory_value_t = computer::memory_value_t;
+
+        static constexpr const uint32_t default_hot_threshold = 8;
+        static constexpr const size_t max_block_instructions = 256;
+
+        explicit computer_jit(uint32_t hot_threshold = default_hot_threshold)
+            : hot_threshold_(hot_threshold)
+        {}
+
+        std::unique_ptr<computer::accelerator> clone() const override {
+            return std::make_unique<computer_jit>(hot_threshold_);
+        }
+
+        bool handles(computer::instruction_code code) const override {
+            switch (code) {
+                case computer::OP_ADD: [[fallthrough]];
+                case computer::OP_MUL: [[fallthrough]];
+                case computer::OP_JNZ: [[fallthrough]];
+                case computer::OP_JZ: [[fallthrough]];
+                case computer::OP_LT: [[fallthrough]];
+                case computer::OP_EQ: [[fallthrough]];
+                case computer::OP_SRB: return true;
+                default: return false;
+            }
+        }
+
+        void run(computer& c) override {
+            auto& ip = register_ref(c, computer::RC_IP);
+            auto& relbase = register_ref(c, computer::RC_RELBASE);
+            auto& memory = memory_of(c);
+            auto size = memory.size();
+
+            context ctx{};
+            while (ip >= 0 && size_t(ip) < size) {
+                auto addr = size_t(ip);
+                if (entries_.size() <= addr)
+                    entries_.resize(addr + 1);
+                auto& entry = entries_[addr];
+                if (!entry.fn) {
+                    if (entry.hits == uncompilable || ++entry.hits < hot_threshold_)
+                        return;
+                    if (!compile(c, addr, entry)) {
+                        entry.hits = uncompilable;
+                        return;
+                    }
+                }
+
+                /* the interpreter may have added pages since the last round */
+                if (code_map_.size() < (memory.page_count() << memory_t::page_bits))
+                    code_map_.resize(memory.page_count() << memory_t::page_bits, 0);
+                ctx.readable = memory.readable_pages();
+                ctx.writable = memory.writable_pages();
+                ctx.page_count = memory.page_count();
+                ctx.code_map = code_map_.data();
+                ctx.stores = store_log_.data();
+                ctx.store_count = 0;
+                ctx.store_end = 0;
+                ctx.relbase = relbase;
+                ctx.ip = ip;
+                ctx.bailed = 0;
+                /* the interpreter cannot decode anything while the block runs, so this is as good as after */
+                for (auto addr : entry.stores)
+                    drop_decoded(c, addr);
+                entry.fn(&ctx);
+                relbase = ctx.relbase;
+                ip = ctx.ip;
+
+                /* stores only go to pages which are there already, but possibly past size() */
+                memory.reserve(size_t(ctx.store_end));
+                if (ctx.store_count > store_log_.size())
+                    drop_decoded(c, 0, memory.size());
+                else for (size_t idx = 0; idx < ctx.store_count; idx++)
+                    drop_decoded(c, size_t(store_log_[idx]));
+                if (ctx.bailed)
+                    return;
+            }
+        }
+
+        void invalidate(size_t address, size_t count) override {
+            auto last = std::min(code_map_.size(), address + count);
+            bool hit{false};
+            for (auto addr = address; addr < last; addr++) {
+                if (code_map_[addr]) {
+                    written_code_.insert(addr);
+                    hit = true;
+                }
+            }
+            if (hit)
+                flush();
+        }
+
+        void flush() override {
+            entries_.clear();
+            std::fill(code_map_.begin(), code_map_.end(), 0);
+            buffer_.reset();
+        }
+
+    private:
+        /* field offsets are baked into the generated code */
+        struct context {
+            const memory_value_t* const* readable;
+            memory_value_t* const* writable;
+            uint64_t page_count;
+            const uint8_t* code_map;
+            /* where computed stores went, the log wraps once store_count passes store_log_size */
+            uint64_t* stores;
+            uint64_t store_count;
+            uint64_t store_end;
+            memory_value_t relbase;
+            memory_value_t ip;
+            uint64_t bailed;
+        };
+        using native_fn_t = void (*)(context*);
+        using memory_t = computer::memory_t;
+
+        static constexpr const uint32_t uncompilable = std::numeric_limits<uint32_t>::max();
+
+        struct entry_t {
+            native_fn_t fn{nullptr};
+            uint32_t hits{0};
+            /* constant addresses the block stores to */
+            std::vector<size_t> stores{};
+        };
+
+        static constexpr const size_t store_log_size = 1024;
+
+        using as = detail::x86_64_assembler;
+
+        static constexpr const as::reg CTX = as::RDI;
+        static constexpr const as::reg PAGES = as::RSI;
+        static constexpr const as::reg CODE_MAP = as::RCX;
+        static constexpr const as::reg STORES = as::R9;
+        static constexpr const as::reg RELBASE = as::R8;
+        static constexpr const as::reg ADDR = as::R10;
+        static constexpr const as::reg SCRATCH = as::R11;
+
+        static inline as::mem field(size_t offset) {
+            return as::mem{CTX, {}, 1, int32_t(offset)};
+        }
+
+        /* ip of every instruction which may bail out, with the jumps that lead to its exit stub */
+        struct pending_exit {
+            memory_value_t ip;
+            std::vector<size_t> patches;
+        };
+
+        bool compile(computer& c, size_t start, entry_t& entry) {
+            const auto& memory = memory_of(c);
+            const auto size = memory.size();
+            const auto word_at = [&](size_t addr) -> std::optional<memory_value_t> {
+                if (addr >= size) return std::nullopt;
+                return memory[addr];
+            };
+            const auto fits = [](memory_value_t v) {
+                return v >= std::numeric_limits<int32_t>::min() / 8 && v <= std::numeric_limits<int32_t>::max() / 8;
+            };
+
+            if (start > size_t(std::numeric_limits<int32_t>::max() - 8))
+                return false;
+
+            as a{};
+            std::vector<pending_exit> exits{};
+            std::vector<size_t> final_jumps{};
+            size_t addr{start};
+            size_t count{0};
+            bool terminated{false};
+
+            a.mov(PAGES, field(offsetof(context, readable)));
+            a.mov(CODE_MAP, field(offsetof(context, code_map)));
+            a.mov(STORES, field(offsetof(context, stores)));
+            a.mov(RELBASE, field(offsetof(context, relbase)));
+            const auto body = a.size();
+
+            while (count < max_block_instructions && !terminated) {
+                auto raw = word_at(addr);
+                if (!raw || *raw < 0)
+                    break;
+                auto code = computer::instruction_code(*raw % 100);
+                if (!handles(code))
+                    break;
+
+                size_t length = (code == computer::OP_SRB) ? 2 : (code == computer::OP_JNZ || code == computer::OP_JZ) ? 3 : 4;
+                std::array<memory_value_t, 3> params{};
+                std::array<computer::addressing_mode, 3> modes{};
+                bool ok{true};
+                auto mode_digits = *raw / 100;
+                for (size_t p = 0; p + 1 < length; p++) {
+                    auto w = word_at(addr + 1 + p);
+                    modes[p] = computer::addressing_mode(mode_digits % 10);
+                    mode_digits /= 10;
+                    if (!w || !fits(*w) || modes[p] >= computer::AM_MAX_ || written_code_.count(addr + 1 + p)) {
+                        ok = false;
+                        break;
+                    }
+                    params[p] = *w;
+                    if (modes[p] == computer::AM_POSITION && *w < 0)
+                        ok = false;
+                }
+                if (!ok || written_code_.count(addr))
+                    break;
+                if ((length == 4) && modes[2] == computer::AM_IMMEDIATE)
+                    break;
+
+                exits.push_back({memory_value_t(addr), {}});
+                auto& bail = exits.back().patches;
+
+                /* addresses past the page table are left to the interpreter */
+                const auto page_of_addr = [&]() {
+                    a.mov(SCRATCH, ADDR);
+                    a.shr(SCRATCH, uint8_t(memory_t::page_bits));
+                    a.cmp(SCRATCH, field(offsetof(context, page_count)));
+                    bail.push_back(a.jcc(as::CC_AE));
+                };
+                const auto load = [&](as::reg dst, size_t p) {
+                    switch (modes[p]) {
+                        case computer::AM_IMMEDIATE:
+                            a.mov(dst, params[p]);
+                            break;
+                        case computer::AM_POSITION: {
+                            auto page = size_t(params[p]) >> memory_t::page_bits;
+                            a.cmp(field(offsetof(context, page_count)), int32_t(page));
+                            bail.push_back(a.jcc(as::CC_BE));
+                            a.mov(dst, as::mem{PAGES, {}, 1, int32_t(page * 8)});
+                            a.mov(dst, as::mem{dst, {}, 1, int32_t((size_t(params[p]) & memory_t::page_mask) * 8)});
+                            break;
+                        }
+                        default:
+                            a.lea(ADDR, RELBASE, int32_t(params[p]));
+                            page_of_addr();
+                            a.mov(SCRATCH, as::mem{PAGES, SCRATCH, 8});
+                            a.and_(ADDR, int32_t(memory_t::page_mask));
+                            a.mov(dst, as::mem{SCRATCH, ADDR, 8});
+                            break;
+                    }
+                };
+                /* clobbers RDX, which holds the page being written */
+                const auto store_rax = [&](size_t p) {
+                    if (modes[p] == computer::AM_POSITION)
+                        a.mov(ADDR, params[p]);
+                    else
+                        a.lea(ADDR, RELBASE, int32_t(params[p]));
+                    page_of_addr();
+                    a.mov(as::RDX, field(offsetof(context, writable)));
+                    a.mov(as::RDX, as::mem{as::RDX, SCRATCH, 8});
+                    a.test(as::RDX, as::RDX);
+                    bail.push_back(a.jcc(as::CC_E));
+                    a.movzx_byte(SCRATCH, as::mem{CODE_MAP, ADDR, 1});
+                    a.test(SCRATCH, SCRATCH);
+                    bail.push_back(a.jcc(as::CC_NE));
+                    a.mov(SCRATCH, ADDR);
+                    a.and_(SCRATCH, int32_t(memory_t::page_mask));
+                    a.mov(as::mem{as::RDX, SCRATCH, 8}, as::RAX);
+
+                    a.lea(SCRATCH, ADDR, 1);
+                    a.cmp(SCRATCH, field(offsetof(context, store_end)));
+                    auto below = a.jcc(as::CC_BE);
+                    a.mov(field(offsetof(context, store_end)), SCRATCH);
+                    a.bind(below, a.size());
+
+                    /* run() drops the interpreter's decoding of whatever was written */
+                    if (modes[p] == computer::AM_POSITION) {
+                        entry.stores.push_back(size_t(params[p]));
+                        return;
+                    }
+                    a.mov(SCRATCH, field(offsetof(context, store_count)));
+                    a.mov(as::RDX, SCRATCH);
+                    a.and_(as::RDX, int32_t(store_log_size - 1));
+                    a.mov(as::mem{STORES, as::RDX, 8}, ADDR);
+                    a.lea(SCRATCH, SCRATCH, 1);
+                    a.mov(field(offsetof(context, store_count)), SCRATCH);
+                };
+
+                switch (code) {
+                    case computer::OP_ADD: [[fallthrough]];
+                    case computer::OP_MUL: [[fallthrough]];
+                    case computer::OP_LT: [[fallthrough]];
+                    case computer::OP_EQ: {
+                        load(as::RAX, 0);
+                        load(as::RDX, 1);
+                        if (code == computer::OP_ADD) {
+                            a.add(as::RAX, as::RDX);
+                        } else if (code == computer::OP_MUL) {
+                            a.imul(as::RAX, as::RDX);
+                        } else {
+                            a.cmp(as::RAX, as::RDX);
+                            a.set_rax(code == computer::OP_LT ? as::CC_L : as::CC_E);
+                        }
+                        store_rax(2);
+                        break;
+                    }
+                    case computer::OP_SRB: {
+                        load(as::RAX, 0);
+                        a.add(RELBASE, as::RAX);
+                        break;
+                    }
+                    case computer::OP_JNZ: [[fallthrough]];
+                    case computer::OP_JZ: {
+                        load(as::RAX, 0);
+                        load(as::RDX, 1);
+                        a.test(as::RAX, as::RAX);
+                        if (modes[1] == computer::AM_IMMEDIATE && size_t(params[1]) == start) {
+                            /* loops back onto this block: stay in native code */
+                            a.bind(a.jcc(code == computer::OP_JNZ ? as::CC_NE : as::CC_E), body);
+                            terminated = true;
+                            break;
+                        }
+                        auto not_taken = a.jcc(code == computer::OP_JNZ ? as::CC_E : as::CC_NE);
+                        a.mov(field(offsetof(context, relbase)), RELBASE);
+                        a.mov(field(offsetof(context, ip)), as::RDX);
+                        a.ret();
+                        a.bind(not_taken, a.size());
+                        terminated = true;
+                        break;
+                    }
+                    default: std::abort();
+                }
+
+                addr += length;
+                count += 1;
+            }
+
+            if (!count)
+                return false;
+
+            emit_exit(a, memory_value_t(addr), false);
+            for (const auto& e : exits) {
+                if (e.patches.empty())
+                    continue;
+                auto target = a.size();
+                for (auto patch : e.patches)
+                    a.bind(patch, target);
+                emit_exit(a, e.ip, true);
+            }
+
+            auto fn = buffer_.append(a.code());
+            if (!fn)
+                return false;
+            entry.fn = reinterpret_cast<native_fn_t>(const_cast<void*>(fn));
+            if (code_map_.size() < addr)
+                code_map_.resize(addr, 0);
+            std::fill(code_map_.begin() + ptrdiff_t(start), code_map_.begin() + ptrdiff_t(addr), 1);
+            return true;
+        }
+
+        /* `bailed` exits stop in front of an instruction the interpreter has to run */
+        static inline void emit_exit(as& a, memory_value_t ip, bool bailed) {
+            a.mov(field(offsetof(context, relbase)), RELBASE);
+            a.mov(field(offsetof(context, ip)), int32_t(ip));
+            if (bailed)
+                a.mov(field(offsetof(context, bailed)), int32_t(1));
+            a.ret();
+        }
+
+        uint32_t hot_threshold_;
+        std::vector<entry_t> entries_{};
+        std::vector<uint8_t> code_map_{};
+        std::unordered_set<size_t> written_code_{};
+        std::array<uint64_t, store_log_size> store_log_{};
+        detail::executable_buffer buffer_{};
+    };
+
+    /* returns false (and leaves `c` interpreted) where the JIT is not available */
+    inline bool enable_jit(computer& c, uint32_t hot_threshold = computer_jit::default_hot_threshold) {
+        c.set_accelerator(std::make_unique<computer_jit>(hot_threshold));
+        return true;
+    }
+#else
+    inline bool enable_jit(computer&, uint32_t = 0) {
+        return false;
+    }
+#endif
+}
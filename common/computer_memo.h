@@ -0,0 +1,160 @@
+#pragma once
+
+#include "computer.h"
+
+#include <list>
+
+/*
+ * Treats a program as a pure function from its inputs to its outputs: every call runs on a computer
+ * rewound to the image and the result is cached, keeping the `capacity` most recently used ones.
+ *
+ * Rewinding hides programs which would read memory left behind by an earlier run (a counter, a table
+ * filled in as it goes), so results can silently differ from reusing one computer for all calls. With
+ * `check_purity` set every miss is stepped in lockstep with a copy of the memory the previous call
+ * left; the first instruction reading a cell whose value differs between the two is reported and
+ * counted in impure_calls(). The copy never runs such an instruction.
+ */
+
+namespace aoc {
+    class memoized_program {
+    public:
+        using value_t = computer::memory_value_t;
+        using inputs_t = std::vector<value_t>;
+        using outputs_t = std::vector<value_t>;
+
+        explicit memoized_program(const computer& image, size_t capacity = 4096, bool check_purity = false)
+            : vm_(image.fork())
+            , capacity_(std::max<size_t>(1, capacity))
+            , check_purity_(check_purity)
+        {
+            vm_.set_baseline();
+        }
+
+        const outputs_t& operator()(const inputs_t& inputs) {
+            if (auto it = index_.find(inputs); it != index_.end()) {
+                hits_ += 1;
+                lru_.splice(lru_.begin(), lru_, it->second);
+                return it->second->second;
+            }
+
+            misses_ += 1;
+            for (auto v : inputs)
+                vm_.add_input(v);
+            if (check_purity_ && carried_)
+                check_purity(inputs);
+            vm_.execute();
+            outputs_t outputs(vm_.outputs().begin(), vm_.outputs().end());
+            if (check_purity_) {
+                carried_ = vm_.fork();
+                carried_->reset();
+            }
+            vm_.reset_to_baseline();
+
+            if (lru_.size() >= capacity_) {
+                index_.erase(lru_.back().first);
+                lru_.pop_back();
+            }
+            lru_.emplace_front(inputs, std::move(outputs));
+            index_.emplace(lru_.front().first, lru_.begin());
+            return lru_.front().second;
+        }
+        template <typename... T>
+        const outputs_t& operator()(T... inputs) {
+            return (*this)(inputs_t{value_t(inputs)...});
+        }
+
+        inline size_t hits() const {
+            return hits_;
+        }
+        inline size_t misses() const {
+            return misses_;
+        }
+        inline size_t impure_calls() const {
+            return impure_calls_;
+        }
+        inline size_t size() const {
+            return lru_.size();
+        }
+
+        void clear() {
+            index_.clear();
+            lru_.clear();
+        }
+
+    private:
+        struct inputs_hash {
+            size_t operator()(const inputs_t& inputs) const {
+                size_t ret{inputs.size()};
+                for (auto v : inputs)
+                    ret = ret * 0x9e3779b97f4a7c15ull + std::hash<value_t>{}(v);
+                return ret;
+            }
+        };
+
+        /* the cells the next instruction of `c` reads, including the ones holding its parameters */
+        static inline size_t reads(const computer& c, std::array<value_t, 7>& addresses) {
+            const auto& m = c.memory();
+            auto ip = c.instruction_pointer();
+            auto op = m.read(ip);
+            size_t inputs{0}, params{0};
+            switch (op % 100) {
+                case computer::OP_ADD: [[fallthrough]];
+                case computer::OP_MUL: [[fallthrough]];
+                case computer::OP_LT: [[fallthrough]];
+                case computer::OP_EQ: inputs = 2; params = 3; break;
+                case computer::OP_JNZ: [[fallthrough]];
+                case computer::OP_JZ: inputs = 2; params = 2; break;
+                case computer::OP_OUT: [[fallthrough]];
+                case computer::OP_SRB: inputs = 1; params = 1; break;
+                case computer::OP_IN: params = 1; break;
+                default: break;
+            }
+            size_t count{0};
+            addresses[count++] = ip;
+            for (size_t p = 0; p < params; p++)
+                addresses[count++] = ip + value_t(p) + 1;
+            for (size_t p = 0; p < inputs; p++) {
+                auto mode = (op / (p ? 1000 : 100)) % 10;
+                if (mode != computer::AM_IMMEDIATE)
+                    addresses[count++] = m.read(ip + value_t(p) + 1) + (mode == computer::AM_RELBASE ? c.relative_base() : 0);
+            }
+            return count;
+        }
+
+        /* steps the call and the memory left by the previous one side by side until they read different values */
+        void check_purity(const inputs_t& inputs) {
+            auto fresh = vm_.fork();
+            auto& carried = *carried_;
+            for (auto v : inputs)
+                carried.add_input(v);
+
+            std::array<value_t, 7> fa{}, ca{};
+            while (!fresh.is_halted()) {
+                auto count = reads(fresh, fa);
+                auto same = reads(carried, ca) == count;
+                for (size_t idx = 0; same && idx < count; idx++)
+                    same = fa[idx] == ca[idx] && (fa[idx] < 0 || fresh.memory().read(fa[idx]) == carried.memory().read(ca[idx]));
+                if (!same) {
+                    if (!impure_calls_++)
+                        fmt::print(::stderr, "IMPURE PROGRAM: inputs {} read memory left by an earlier call at IP={}\n",
+                                   inputs, fresh.instruction_pointer());
+                    return;
+                }
+                fresh.single_step();
+                carried.single_step();
+            }
+        }
+
+        using entry_t = std::pair<inputs_t, outputs_t>;
+
+        computer vm_;
+        std::optional<computer> carried_{};
+        size_t capacity_;
+        bool check_purity_;
+        std::list<entry_t> lru_{};
+        std::unordered_map<inputs_t, std::list<entry_t>::iterator, inputs_hash> index_{};
+        size_t hits_{0};
+        size_t misses_{0};
+        size_t impure_calls_{0};
+    };
+}
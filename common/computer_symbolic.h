@@ -0,0 +1,442 @@
+#pragma once
+
+#include "computer.h"
+
+#include <cmath>
+
+/*
+ * Symbolic execution of Intcode programs. Chosen memory cells (and, optionally, inputs) hold unknowns
+ * instead of numbers; the program then runs forward on expressions, which are kept as a hash-consed DAG
+ * with constants folded on the way. Once it halts, the value of any cell or output can be expanded into
+ * a polynomial of the unknowns and, if its degree is low enough, solved for a target value.
+ *
+ * Opcodes, jump conditions, jump targets and store addresses have to come out concrete. If one does not
+ * the run stops and reports where and why instead of picking a branch. A load from a symbolic address
+ * is kept as an opaque node, which is fine as long as the result does not end up depending on it.
+ */
+
+namespace aoc {
+    class symbolic_computer {
+    public:
+        using value_t = computer::memory_value_t;
+        using node_id = uint32_t;
+
+        enum node_kind : uint8_t {
+            NK_CONST,
+            NK_SYMBOL,
+            NK_ADD,
+            NK_MUL,
+            NK_LT,
+            NK_EQ,
+            NK_LOAD,
+        };
+
+        struct node_t {
+            node_kind kind;
+            value_t a;
+            value_t b;
+        };
+
+        enum run_status {
+            SR_HALTED,
+            SR_NEEDS_INPUT,
+            SR_SYMBOLIC_OPCODE,
+            SR_SYMBOLIC_JUMP,
+            SR_SYMBOLIC_ADDRESS,
+            SR_INVALID_INSTRUCTION,
+            SR_STEP_LIMIT,
+        };
+
+        /* where and why a run stopped; `culprit` is the expression that could not be resolved */
+        struct run_result {
+            run_status status;
+            size_t ip;
+            std::optional<node_id> culprit;
+        };
+
+        /* exponent of every symbol, indexed by symbol number */
+        using monomial_t = std::vector<uint8_t>;
+        using polynomial_t = std::map<monomial_t, value_t>;
+
+        /* inclusive range of values a symbol may take */
+        struct symbol_range {
+            value_t first;
+            value_t last;
+        };
+
+        /* starts from the memory image of `c` at IP 0 with a zero relative base */
+        explicit symbolic_computer(const computer& c)
+            : image_(c.memory().to_vector())
+        {}
+
+        /* makes address `address` hold a new unknown and returns its symbol number */
+        size_t make_symbol(size_t address, std::string name) {
+            memory_[address] = symbol(std::move(name));
+            return symbol_names_.size() - 1;
+        }
+        /* the next IN reads a new unknown */
+        size_t add_symbolic_input(std::string name) {
+            inputs_.push_back(symbol(std::move(name)));
+            return symbol_names_.size() - 1;
+        }
+        void add_input(value_t v) {
+            inputs_.push_back(constant(v));
+        }
+
+        inline node_id cell(size_t address) {
+            auto it = memory_.find(address);
+            if (it != memory_.end())
+                return it->second;
+            return constant(address < image_.size() ? image_[address] : 0);
+        }
+        inline const std::vector<node_id>& outputs() const {
+            return outputs_;
+        }
+        inline const node_t& node(node_id id) const {
+            return nodes_[id];
+        }
+        inline size_t symbol_count() const {
+            return symbol_names_.size();
+        }
+
+        run_result run(size_t max_steps = 1'000'000) {
+            for (size_t step = 0; step < max_steps; step++) {
+                auto op = concrete(cell(ip_));
+                if (!op)
+                    return stop(SR_SYMBOLIC_OPCODE, cell(ip_));
+
+                auto code = *op % 100;
+                auto mode = [op = *op](size_t param) {
+                    auto div = param == 0 ? 100 : param == 1 ? 1000 : 10000;
+                    return computer::addressing_mode((op / div) % 10);
+                };
+
+                std::optional<node_id> culprit{};
+                auto address = [&](size_t param) -> std::optional<size_t> {
+                    auto raw = ip_ + param + 1;
+                    if (mode(param) == computer::AM_IMMEDIATE)
+                        return raw;
+                    auto v = concrete(cell(raw));
+                    if (v && mode(param) == computer::AM_RELBASE)
+                        *v += relbase_;
+                    if (!v || *v < 0) {
+                        culprit = cell(raw);
+                        return std::nullopt;
+                    }
+                    return size_t(*v);
+                };
+                auto load = [&](size_t param) {
+                    if (auto addr = address(param))
+                        return cell(*addr);
+                    return intern(NK_LOAD, value_t(*culprit), 0);
+                };
+                auto store = [&](size_t param, node_id v) {
+                    auto addr = address(param);
+                    if (addr)
+                        memory_[*addr] = v;
+                    return addr.has_value();
+                };
+
+                switch (code) {
+                    case computer::OP_ADD:
+                    case computer::OP_MUL:
+                    case computer::OP_LT:
+                    case computer::OP_EQ: {
+                        auto a = load(0);
+                        auto b = load(1);
+                        auto kind = code == computer::OP_ADD ? NK_ADD : code == computer::OP_MUL ? NK_MUL
+                                  : code == computer::OP_LT ? NK_LT : NK_EQ;
+                        if (!store(2, make(kind, a, b)))
+                            return stop(SR_SYMBOLIC_ADDRESS, *culprit);
+                        ip_ += 4;
+                        break;
+                    }
+                    case computer::OP_IN: {
+                        if (inputs_.empty())
+                            return stop(SR_NEEDS_INPUT);
+                        if (!store(0, inputs_.front()))
+                            return stop(SR_SYMBOLIC_ADDRESS, *culprit);
+                        inputs_.pop_front();
+                        ip_ += 2;
+                        break;
+                    }
+                    case computer::OP_OUT: {
+                        outputs_.push_back(load(0));
+                        ip_ += 2;
+                        break;
+                    }
+                    case computer::OP_JNZ:
+                    case computer::OP_JZ: {
+                        auto cond = load(0);
+                        auto v = concrete(cond);
+                        if (!v)
+                            return stop(SR_SYMBOLIC_JUMP, cond);
+                        if ((*v != 0) == (code == computer::OP_JNZ)) {
+                            auto target = load(1);
+                            auto t = concrete(target);
+                            if (!t || *t < 0)
+                                return stop(SR_SYMBOLIC_JUMP, target);
+                            ip_ = size_t(*t);
+                        } else {
+                            ip_ += 3;
+                        }
+                        break;
+                    }
+                    case computer::OP_SRB: {
+                        auto v = concrete(load(0));
+                        if (!v)
+                            return stop(SR_SYMBOLIC_ADDRESS, load(0));
+                        relbase_ += *v;
+                        ip_ += 2;
+                        break;
+                    }
+                    case computer::OP_HLT:
+                        return stop(SR_HALTED);
+                    default:
+                        return stop(SR_INVALID_INSTRUCTION);
+                }
+            }
+            return stop(SR_STEP_LIMIT);
+        }
+
+        /* `id` as a polynomial of the unknowns, unless it is not one or its degree exceeds `max_degree` */
+        std::optional<polynomial_t> to_polynomial(node_id id, size_t max_degree = 4) const {
+            std::unordered_map<node_id, std::optional<polynomial_t>> memo{};
+            return expand(id, max_degree, memo);
+        }
+
+        /*
+         * Values for all unknowns which make `id` evaluate to `target`, trying the earlier symbols in
+         * ascending order and solving for the last one directly, so the last symbol may appear with at most
+         * degree two. The first solution in that order is returned.
+         */
+        std::optional<std::vector<value_t>> solve(node_id id, value_t target, const std::vector<symbol_range>& ranges) const {
+            auto poly = to_polynomial(id);
+            if (!poly || ranges.size() != symbol_count() || ranges.empty())
+                return std::nullopt;
+            auto last = symbol_count() - 1;
+            for (const auto& [m, coef] : *poly) {
+                if (m[last] > 2)
+                    return std::nullopt;
+            }
+
+            std::vector<value_t> values(symbol_count());
+            for (size_t idx = 0; idx < last; idx++)
+                values[idx] = ranges[idx].first;
+            while (true) {
+                /* a * x^2 + b * x + c with the earlier symbols plugged in */
+                std::array<__int128, 3> abc{};
+                for (const auto& [m, coef] : *poly) {
+                    __int128 term = coef;
+                    for (size_t idx = 0; idx < last; idx++) {
+                        for (size_t e = 0; e < m[idx]; e++)
+                            term *= values[idx];
+                    }
+                    abc[m[last]] += term;
+                }
+                abc[0] -= target;
+                if (auto x = solve_quadratic(abc[2], abc[1], abc[0], ranges[last])) {
+                    values[last] = *x;
+                    return values;
+                }
+
+                size_t idx = last;
+                while (idx > 0 && values[idx - 1] == ranges[idx - 1].last) {
+                    values[idx - 1] = ranges[idx - 1].first;
+                    idx--;
+                }
+                if (idx == 0)
+                    return std::nullopt;
+                values[idx - 1]++;
+            }
+        }
+
+        std::string to_string(node_id id) const {
+            const auto& n = nodes_[id];
+            switch (n.kind) {
+                case NK_CONST: return fmt::format("{}", n.a);
+                case NK_SYMBOL: return symbol_names_[size_t(n.a)];
+                case NK_ADD: return fmt::format("({} + {})", to_string(node_id(n.a)), to_string(node_id(n.b)));
+                case NK_MUL: return fmt::format("({} * {})", to_string(node_id(n.a)), to_string(node_id(n.b)));
+                case NK_LT: return fmt::format("({} < {})", to_string(node_id(n.a)), to_string(node_id(n.b)));
+                case NK_EQ: return fmt::format("({} == {})", to_string(node_id(n.a)), to_string(node_id(n.b)));
+                case NK_LOAD: return fmt::format("[{}]", to_string(node_id(n.a)));
+            }
+            return "?";
+        }
+
+        std::string describe(const run_result& r) const {
+            static constexpr const char* reasons[] = {
+                "halted", "needs input", "symbolic opcode", "unresolved jump", "symbolic address",
+                "invalid instruction", "step limit reached",
+            };
+            if (r.culprit)
+                return fmt::format("{} at IP={}: {}", reasons[r.status], r.ip, to_string(*r.culprit));
+            return fmt::format("{} at IP={}", reasons[r.status], r.ip);
+        }
+
+    private:
+        inline run_result stop(run_status status, std::optional<node_id> culprit = std::nullopt) const {
+            return {status, ip_, culprit};
+        }
+
+        inline std::optional<value_t> concrete(node_id id) const {
+            if (nodes_[id].kind == NK_CONST)
+                return nodes_[id].a;
+            return std::nullopt;
+        }
+
+        node_id intern(node_kind kind, value_t a, value_t b) {
+            auto [it, inserted] = interned_.try_emplace({kind, a, b}, node_id(nodes_.size()));
+            if (inserted)
+                nodes_.push_back({kind, a, b});
+            return it->second;
+        }
+        inline node_id constant(value_t v) {
+            return intern(NK_CONST, v, 0);
+        }
+        node_id symbol(std::string name) {
+            symbol_names_.push_back(std::move(name));
+            return intern(NK_SYMBOL, value_t(symbol_names_.size() - 1), 0);
+        }
+
+        /* folds constants and the usual identities, orders the operands of commutative nodes */
+        node_id make(node_kind kind, node_id a, node_id b) {
+            auto ca = concrete(a);
+            auto cb = concrete(b);
+            if (ca && cb) {
+                switch (kind) {
+                    case NK_ADD: return constant(*ca + *cb);
+                    case NK_MUL: return constant(*ca * *cb);
+                    case NK_LT: return constant(*ca < *cb);
+                    case NK_EQ: return constant(*ca == *cb);
+                    default: break;
+                }
+            }
+            if (kind == NK_ADD && ca == 0)
+                return b;
+            if (kind == NK_ADD && cb == 0)
+                return a;
+            if (kind == NK_MUL && (ca == 0 || cb == 0))
+                return constant(0);
+            if (kind == NK_MUL && ca == 1)
+                return b;
+            if (kind == NK_MUL && cb == 1)
+                return a;
+            if (kind == NK_EQ && a == b)
+                return constant(1);
+            if (kind == NK_LT && a == b)
+                return constant(0);
+            if ((kind == NK_ADD || kind == NK_MUL || kind == NK_EQ) && a > b)
+                std::swap(a, b);
+            return intern(kind, value_t(a), value_t(b));
+        }
+
+        std::optional<polynomial_t> expand(node_id id, size_t max_degree,
+                                           std::unordered_map<node_id, std::optional<polynomial_t>>& memo) const {
+            if (auto it = memo.find(id); it != memo.end())
+                return it->second;
+
+            std::optional<polynomial_t> ret{};
+            const auto& n = nodes_[id];
+            switch (n.kind) {
+                case NK_CONST:
+                    ret = polynomial_t{};
+                    if (n.a)
+                        (*ret)[monomial_t(symbol_count())] = n.a;
+                    break;
+                case NK_SYMBOL: {
+                    monomial_t m(symbol_count());
+                    m[size_t(n.a)] = 1;
+                    ret = polynomial_t{{m, 1}};
+                    break;
+                }
+                case NK_ADD: {
+                    auto pa = expand(node_id(n.a), max_degree, memo);
+                    auto pb = expand(node_id(n.b), max_degree, memo);
+                    if (!pa || !pb)
+                        break;
+                    ret = *pa;
+                    for (const auto& [m, coef] : *pb)
+                        accumulate(*ret, m, coef);
+                    break;
+                }
+                case NK_MUL: {
+                    auto pa = expand(node_id(n.a), max_degree, memo);
+                    auto pb = expand(node_id(n.b), max_degree, memo);
+                    if (!pa || !pb)
+                        break;
+                    ret = polynomial_t{};
+                    for (const auto& [ma, ca] : *pa) {
+                        for (const auto& [mb, cb] : *pb) {
+                            monomial_t m(symbol_count());
+                            size_t degree{0};
+                            for (size_t idx = 0; idx < m.size(); idx++)
+                                degree += (m[idx] = uint8_t(ma[idx] + mb[idx]));
+                            if (degree > max_degree) {
+                                ret.reset();
+                                break;
+                            }
+                            accumulate(*ret, m, ca * cb);
+                        }
+                        if (!ret)
+                            break;
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+            return memo[id] = ret;
+        }
+
+        static inline void accumulate(polynomial_t& p, const monomial_t& m, value_t coef) {
+            if (!(p[m] += coef))
+                p.erase(m);
+        }
+
+        /* smallest integer root of a * x^2 + b * x + c inside `range` */
+        static std::optional<value_t> solve_quadratic(__int128 a, __int128 b, __int128 c, symbol_range range) {
+            std::vector<__int128> roots{};
+            if (a == 0 && b == 0) {
+                if (c == 0)
+                    return range.first;
+            } else if (a == 0) {
+                if (c % b == 0)
+                    roots.push_back(-c / b);
+            } else {
+                auto d = b * b - 4 * a * c;
+                if (d < 0)
+                    return std::nullopt;
+                auto s = __int128(std::sqrt(double(d)));
+                while (s * s > d)
+                    s--;
+                while ((s + 1) * (s + 1) <= d)
+                    s++;
+                if (s * s != d)
+                    return std::nullopt;
+                for (auto num : {-b - s, -b + s}) {
+                    if (num % (2 * a) == 0)
+                        roots.push_back(num / (2 * a));
+                }
+            }
+            std::optional<value_t> ret{};
+            for (auto r : roots) {
+                if (r >= range.first && r <= range.last && (!ret || r < *ret))
+                    ret = value_t(r);
+            }
+            return ret;
+        }
+
+        std::vector<value_t> image_;
+        std::unordered_map<size_t, node_id> memory_{};
+        std::deque<node_id> inputs_{};
+        std::vector<node_id> outputs_{};
+        size_t ip_{0};
+        value_t relbase_{0};
+
+        std::vector<node_t> nodes_{};
+        std::map<std::tuple<node_kind, value_t, value_t>, node_id> interned_{};
+        std::vector<std::string> symbol_names_{};
+    };
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "computer.h"
+
+/*
+ * Reads back a trace written by a computer with recording_policy (see trace_recorder for the format).
+ * Nothing is executed: memory is rebuilt by applying the recorded writes to the image in the header and
+ * the only thing ever decoded is an instruction's length, to know where the next one would start.
+ */
+
+namespace aoc {
+    class trace_replay {
+    public:
+        using value_t = int64_t;
+
+        struct state {
+            std::vector<value_t> memory{};
+            value_t ip{0};
+            value_t relbase{0};
+            uint64_t instructions{0};
+            std::vector<value_t> inputs{};
+            std::vector<value_t> outputs{};
+            /* every recorded instruction has been applied */
+            bool finished{false};
+        };
+
+        explicit trace_replay(const std::string& path) {
+            if (!file_.open(path)) {
+                fmt::print(::stderr, "CANNOT OPEN TRACE {}: {}\n", path, std::strerror(errno));
+                std::abort();
+            }
+            cursor c{file_.data(), file_.data() + file_.size()};
+            if (file_.size() < sizeof(trace_recorder::magic) ||
+                !std::equal(std::begin(trace_recorder::magic), std::end(trace_recorder::magic), c.in))
+                corrupt("bad magic");
+            c.in += sizeof(trace_recorder::magic);
+            if (c.next() != trace_recorder::version)
+                corrupt("unsupported version");
+            image_.resize(size_t(c.next()));
+            for (auto& v : image_)
+                v = c.next_signed();
+            ip_ = c.next_signed();
+            relbase_ = c.next_signed();
+            events_ = c.in;
+
+            state s{};
+            replay(s, std::numeric_limits<uint64_t>::max());
+            instructions_ = s.instructions;
+        }
+
+        inline uint64_t instructions() const {
+            return instructions_;
+        }
+
+        /* the state right before instruction `count` (counting from 0) or at the end of the trace */
+        state at(uint64_t count) const {
+            state s{};
+            replay(s, count);
+            return s;
+        }
+
+        /* puts `c` in the state at(count) describes, except for its I/O queues which are left empty */
+        template <typename policy>
+        void restore(basic_computer<policy>& c, uint64_t count) const {
+            auto s = at(count);
+            c.clear();
+            c.expand_memory(s.memory.size());
+            for (size_t addr = 0; addr < s.memory.size(); addr++) {
+                if (s.memory[addr])
+                    c.mem_ref(value_t(addr), basic_computer<policy>::AM_IMMEDIATE) = s.memory[addr];
+            }
+            c.set_instruction_pointer(s.ip);
+            c.set_relative_base(s.relbase);
+        }
+
+        /* the first instruction whose recorded effects differ between two traces, if any */
+        static std::optional<uint64_t> first_difference(const trace_replay& a, const trace_replay& b) {
+            if (a.image_ != b.image_ || a.ip_ != b.ip_ || a.relbase_ != b.relbase_)
+                return 0;
+            cursor ca{a.events_, a.file_.data() + a.file_.size()};
+            cursor cb{b.events_, b.file_.data() + b.file_.size()};
+            uint64_t steps{0};
+            while (ca.in < ca.end && cb.in < cb.end) {
+                auto ea = ca.next();
+                auto eb = cb.next();
+                auto is_step = bool(ea & 1);
+                auto operands = is_step ? 0 : (ea >> 1) == trace_recorder::EK_WRITE ? 2 : 1;
+                auto same = ea == eb;
+                for (int idx = 0; idx < operands; idx++)
+                    same = ca.next() == cb.next() && same;
+                if (!same)
+                    return is_step || !steps ? steps : steps - 1;
+                if (is_step)
+                    steps += 1;
+                else if ((ea >> 1) == trace_recorder::EK_END || (ea >> 1) == trace_recorder::EK_NONE)
+                    return std::nullopt;
+            }
+            return ca.in < ca.end || cb.in < cb.end ? std::optional<uint64_t>{steps} : std::nullopt;
+        }
+
+    private:
+        struct cursor {
+            const uint8_t* in;
+            const uint8_t* end;
+
+            inline uint64_t next() {
+                uint64_t v{};
+                if (!detail::get_varint(in, end, v))
+                    corrupt("truncated");
+                return v;
+            }
+            inline value_t next_signed() {
+                return detail::unzigzag(next());
+            }
+        };
+
+        [[noreturn]] static void corrupt(const char* why) {
+            fmt::print(::stderr, "CORRUPT TRACE: {}\n", why);
+            std::abort();
+        }
+
+        static inline value_t length(value_t op) {
+            switch (op % 100) {
+                case 1: case 2: case 7: case 8: return 4;
+                case 5: case 6: return 3;
+                case 3: case 4: case 9: return 2;
+                case 99: return 1;
+                default: return 0;
+            }
+        }
+
+        void replay(state& s, uint64_t count) const {
+            s.memory = image_;
+            s.ip = ip_;
+            s.relbase = relbase_;
+            auto poke = [&s](value_t address, value_t value) {
+                if (address < 0)
+                    corrupt("negative address");
+                if (size_t(address) >= s.memory.size())
+                    s.memory.resize(size_t(address) + 1);
+                s.memory[size_t(address)] = value;
+            };
+            auto peek = [&s](value_t address) {
+                return address >= 0 && size_t(address) < s.memory.size() ? s.memory[size_t(address)] : 0;
+            };
+
+            cursor c{events_, file_.data() + file_.size()};
+            value_t next{ip_};
+            value_t address{0};
+            while (c.in < c.end) {
+                auto e = c.next();
+                if (e & 1) {
+                    s.ip = next + detail::unzigzag(e >> 1);
+                    if (s.instructions == count)
+                        return;
+                    next = s.ip + length(peek(s.ip));
+                    s.instructions += 1;
+                    continue;
+                }
+                switch (e >> 1) {
+                    case trace_recorder::EK_WRITE:
+                        address += c.next_signed();
+                        poke(address, c.next_signed());
+                        break;
+                    case trace_recorder::EK_RELBASE:
+                        s.relbase += c.next_signed();
+                        break;
+                    case trace_recorder::EK_INPUT:
+                        s.inputs.push_back(c.next_signed());
+                        break;
+                    case trace_recorder::EK_OUTPUT:
+                        s.outputs.push_back(c.next_signed());
+                        break;
+                    case trace_recorder::EK_END:
+                        s.ip = next + c.next_signed();
+                        s.finished = true;
+                        return;
+                    case trace_recorder::EK_NONE:
+                        s.ip = next;
+                        s.finished = true;
+                        return;
+                    default:
+                        corrupt("unknown event");
+                }
+            }
+            s.ip = next;
+            s.finished = true;
+        }
+
+        detail::mapped_file file_{};
+        std::vector<value_t> image_{};
+        value_t ip_{0};
+        value_t relbase_{0};
+        const uint8_t* events_{nullptr};
+        uint64_t instructions_{0};
+    };
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "aoc.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace aoc {
+    /*
+     * Fixed set of worker threads which all run the same job. run() hands `fn(worker_index)` to every
+     * worker and returns once all of them are done; parallel_for() builds on it to spread an index
+     * range over the workers in small chunks.
+     */
+    class thread_pool {
+    public:
+        static inline size_t default_size() {
+            return std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+
+        explicit thread_pool(size_t size = default_size()) {
+            for (size_t idx = 0; idx < std::max<size_t>(1, size); idx++)
+                workers_.emplace_back([this, idx] { work(idx); });
+        }
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+        ~thread_pool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            start_.notify_all();
+            for (auto& t : workers_)
+                t.join();
+        }
+
+        inline size_t size() const {
+            return workers_.size();
+        }
+
+        template <typename F>
+        void run(F&& fn) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            job_ = std::forward<F>(fn);
+            running_ = workers_.size();
+            generation_ += 1;
+            start_.notify_all();
+            done_.wait(lock, [this] { return !running_; });
+            job_ = nullptr;
+        }
+
+        /* `fn` gets called as fn(index) or, to keep per-worker state, as fn(index, worker_index) */
+        template <typename F>
+        void parallel_for(size_t count, F&& fn, size_t chunk = 1) {
+            std::atomic<size_t> next{0};
+            run([&](size_t worker) {
+                for (auto first = next.fetch_add(chunk); first < count; first = next.fetch_add(chunk)) {
+                    for (auto idx = first; idx < std::min(count, first + chunk); idx++) {
+                        if constexpr (std::is_invocable_v<F&, size_t, size_t>)
+                            fn(idx, worker);
+                        else
+                            fn(idx);
+                    }
+                }
+            });
+        }
+
+    private:
+        void work(size_t idx) {
+            uint64_t seen{0};
+            while (true) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                start_.wait(lock, [this, seen] { return stopping_ || generation_ != seen; });
+                if (stopping_)
+                    return;
+                seen = generation_;
+                lock.unlock();
+
+                job_(idx);
+
+                lock.lock();
+                if (!--running_)
+                    done_.notify_all();
+            }
+        }
+
+        std::vector<std::thread> workers_{};
+        std::mutex mutex_{};
+        std::condition_variable start_{};
+        std::condition_variable done_{};
+        std::function<void(size_t)> job_{};
+        uint64_t generation_{0};
+        size_t running_{0};
+        bool stopping_{false};
+    };
+}
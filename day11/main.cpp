@@ -119,18 +119,11 @@ static inline void run(const aoc::computer& computer, point_map& path,
     point current_position{0, 0};
     orientation current_orientation{initial_orientation};
 
-    c.expand_memory(1024 * 1024);
-
-    static constexpr const auto bp = [](const aoc::computer& c) -> bool {
-        return c.outputs().size() == 2;
-    };
-
     write_point(path, current_position, initial_color);
 
     while (true) {
         c.add_input(read_point(path, current_position));
-        c.execute_with_conditional_breakpoints({bp});
-        if (c.is_halted())
+        if (c.execute_until_blocked(2) == aoc::computer::BR_HALTED)
             break;
 
         auto color = c.get_output().value();
@@ -1,4 +1,4 @@
-#include <computer.h>
+#include <computer_aot.h>
 
 enum direction : char {
     UP = '^',
@@ -184,8 +184,6 @@ public:
 };
 
 struct scaffolding {
-    static constexpr const size_t program_memory_size = 128 * 1024;
-
     std::vector<std::vector<char>> data;
     std::string original_program;
     aoc::computer comp;
@@ -282,10 +280,7 @@ struct scaffolding {
     }
 
     inline auto run_cleaning_program(const std::array<std::string, 5>& program) {
-        comp.reset(comp.memory().size() - 100, original_program.size());
-        comp.clear();
-        comp.add_memory_values(original_program);
-        comp.expand_memory(scaffolding::program_memory_size);
+        comp.reset_to_baseline();
         comp.mem_ref(0, aoc::computer::AM_IMMEDIATE) = 2;
         for (const auto& line : program) {
             auto sv_line = std::string_view(line);
@@ -310,7 +305,8 @@ struct scaffolding {
         std::getline(in, ret.original_program);
         ret.comp = aoc::computer();
         ret.comp.add_memory_values(ret.original_program);
-        ret.comp.expand_memory(scaffolding::program_memory_size);
+        ret.comp.set_baseline();
+        aoc::enable_compiled_program(ret.comp);
         ret.comp.execute();
 
         std::vector<char> line{};
@@ -495,10 +491,24 @@ done:
     fmt::print("{}\n", ret);
 }
 
+/* the camera image once more on the interpreter, with its pairs fused and counted, has to be the one the compiled program drew */
+static inline void check_fusions(const scaffolding& s) {
+    aoc::basic_computer<aoc::counting_policy> counted;
+    counted.add_memory_values(s.original_program);
+    counted.execute();
+    counted.fusions().report(stderr);
+    if (!std::equal(counted.outputs().begin(), counted.outputs().end(), s.comp.outputs().begin(), s.comp.outputs().end())) {
+        fmt::print(::stderr, "FUSED CAMERA DIFFERS\n");
+        std::abort();
+    }
+}
+
 int main() {
     auto s = scaffolding::read();
 
     part1(s);
+    if constexpr (DEBUG)
+        check_fusions(s);
     part2(s);
 
     return 0;
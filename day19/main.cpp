@@ -1,19 +1,19 @@
-#include <computer.h>
+#include <computer_aot.h>
+#include <computer_batch.h>
+#include <computer_memo.h>
 
-using value_type = aoc::computer::memory_value_t;
+#include <filesystem>
 
-static value_type s_50_x{0};
-static value_type e_50_x{0};
+using value_type = aoc::computer::memory_value_t;
 
-static inline auto value_at(const aoc::computer& c, size_t x, size_t y) {
-    aoc::computer cc(c);
-    cc.add_input({x, y});
-    cc.expand_memory(1024);
-    cc.execute();
-    return cc.outputs().back();
+static inline auto value_at(aoc::computer_pool& c, size_t x, size_t y) {
+    auto cc = c.acquire();
+    cc->add_input({x, y});
+    cc->execute();
+    return cc->outputs().back();
 };
 
-static inline auto line_width(const aoc::computer& c, value_type line, value_type &start_x, value_type& end_x) {
+static inline auto line_width(aoc::computer_pool& c, value_type line, value_type &start_x, value_type& end_x) {
     static std::unordered_map<value_type, std::pair<value_type, value_type>> known_lengths{};
     if (auto it = known_lengths.find(line); it != known_lengths.end()) {
         start_x = it->second.second;
@@ -50,19 +50,26 @@ static inline auto line_width(const aoc::computer& c, value_type line, value_typ
     return ret;
 }
 
-static inline void part1(const aoc::computer& c_in) {
-    value_type ret{0};
-    for (aoc::computer::memory_value_t y = 0; y < 50; y++) {
-        auto w = line_width(c_in, y, s_50_x, e_50_x);
-        ret += w;
+/* every point of the 50x50 area is an independent probe, so they all go through the batch engine */
+static inline void part1(const aoc::computer& c) {
+    std::vector<std::vector<value_type>> probes{};
+    for (value_type y = 0; y < 50; y++) {
+        for (value_type x = 0; x < 50; x++)
+            probes.push_back({x, y});
     }
+
+    aoc::batch_computer<> batch(c);
+    value_type ret{0};
+    for (const auto& out : batch.run(probes))
+        ret += out.back();
     fmt::print("{}\n", ret);
 }
 
-static inline void part2(const aoc::computer& c) {
-    value_type top_s_x{s_50_x};
-    value_type top_e_x{e_50_x};
+static inline void part2(aoc::computer_pool& c) {
+    value_type top_s_x{0};
+    value_type top_e_x{0};
     value_type top_y{51};
+    line_width(c, 49, top_s_x, top_e_x);
 
     auto width = line_width(c, top_y, top_s_x, top_e_x);
     while (width < 100) {
@@ -85,9 +92,56 @@ static inline void part2(const aoc::computer& c) {
 
 int main() {
     auto c = aoc::computer::read_initial_state();
+    aoc::enable_compiled_program(c);
+    aoc::computer_pool pool(c);
 
     part1(c);
-    part2(c);
+    part2(pool);
+
+    if constexpr (DEBUG) {
+        /* a second sweep of the part 1 area has to come out of the cache and agree with the first */
+        aoc::memoized_program beam(c, 50 * 50);
+        for (size_t pass = 0; pass < 2; pass++) {
+            for (size_t y = 0; y < 50; y++) {
+                for (size_t x = 0; x < 50; x++) {
+                    if (beam(x, y).back() != value_at(pool, x, y)) {
+                        fmt::print(::stderr, "MEMOIZED PROBE ({}, {}) DIFFERS\n", x, y);
+                        std::abort();
+                    }
+                }
+            }
+        }
+        fmt::print("beam probes: {} hits, {} misses\n", beam.hits(), beam.misses());
+
+        /* reset_to_baseline() keeps pages past the baseline; a snapshot taken after it still has to load */
+        const auto round_trip = [](const aoc::computer& vm, std::string_view what) {
+            auto path = (std::filesystem::temp_directory_path() / "day19.snapshot").string();
+            aoc::computer loaded{};
+            bool same = vm.save_snapshot(path) && loaded.load_snapshot(path) && loaded.memory().to_vector() == vm.memory().to_vector();
+            std::filesystem::remove(path);
+            if (!same) {
+                fmt::print(::stderr, "SNAPSHOT OF {} DIFFERS\n", what);
+                std::abort();
+            }
+            return loaded;
+        };
+        aoc::computer grown{};
+        grown.add_memory_values("1101,1,2,10000,99");
+        grown.set_baseline();
+        grown.execute();
+        grown.reset_to_baseline();
+        round_trip(grown, "A RESET COMPUTER");
+        {
+            auto probed = value_at(pool, 10, 10);
+            auto loaded = round_trip(*pool.acquire(), "A POOLED COMPUTER");
+            loaded.add_input({10, 10});
+            loaded.execute();
+            if (loaded.outputs().back() != probed) {
+                fmt::print(::stderr, "PROBE FROM A SNAPSHOT DIFFERS\n");
+                std::abort();
+            }
+        }
+    }
 
     return 0;
 }
@@ -1,93 +1,110 @@
-#include <aoc.h>
+#include <computer_symbolic.h>
+#include <thread_pool.h>
 
-using memory_value_t = long;
+using value_t = aoc::computer::memory_value_t;
 
-enum instruction_codes : memory_value_t {
-    OP_ADD = 1,
-    OP_MUL = 2,
-    OP_HLT = 99
-};
+/* inclusive range of values to try for the noun or the verb */
+struct search_range {
+    value_t first;
+    value_t last;
 
-struct computer_state {
-    std::vector<memory_value_t> memory;
-    size_t ip;
+    inline size_t size() const {
+        return size_t(last - first + 1);
+    }
 };
 
-static inline struct computer_state read_initial_state() {
-    memory_value_t v{};
-    std::string buff;
-    std::vector<memory_value_t> memory;
-    while (std::getline(std::cin, buff, ',')) {
-        std::string_view sv = aoc::trim(buff);
-        if (sv.empty()) continue;
-        auto ret = std::from_chars(sv.cbegin(), sv.cend(), v);
-        if (ret.ec != std::errc()) break;
-        memory.push_back(v);
-    }
-    return {std::move(memory), 0};
+/* patches noun and verb into a computer rewound to its baseline and returns what ends up at address 0 */
+static inline value_t compute(aoc::computer& computer, value_t noun, value_t verb) {
+    computer.reset_to_baseline();
+    computer.mem_ref(1, aoc::computer::AM_IMMEDIATE) = noun;
+    computer.mem_ref(2, aoc::computer::AM_IMMEDIATE) = verb;
+    computer.execute();
+    return computer.memory()[0];
 }
 
-static inline void execute_program(struct computer_state& state) {
-    auto& memory = state.memory;
-    while (state.ip < memory.size()) {
-        switch (memory.at(state.ip)) {
-            case OP_ADD: {
-                auto v1 = memory[size_t(memory[state.ip + 1])];
-                auto v2 = memory[size_t(memory[state.ip + 2])];
-                memory[size_t(memory[state.ip + 3])] = v1 + v2;
-                state.ip += 4;
-                break;
-            }
-            case OP_MUL: {
-                auto v1 = memory[size_t(memory[state.ip + 1])];
-                auto v2 = memory[size_t(memory[state.ip + 2])];
-                memory[size_t(memory[state.ip + 3])] = v1 * v2;
-                state.ip += 4;
-                break;
-            }
-            case OP_HLT: {
-                state.ip = memory.size() + 1;
-                break;
-            }
-        }
+/*
+ * Tries every (noun, verb) pair on all workers of the pool. The first match in search order wins: once
+ * some worker finds one, the pairs after it are skipped by everybody.
+ */
+static inline std::optional<std::pair<value_t, value_t>> find_inputs(aoc::thread_pool& pool, const aoc::computer& computer,
+                                                                     search_range nouns, search_range verbs, value_t target) {
+    std::vector<aoc::computer> vms{};
+    for (size_t idx = 0; idx < pool.size(); idx++) {
+        vms.push_back(computer.fork());
+        vms.back().set_baseline();
     }
+
+    auto count = nouns.size() * verbs.size();
+    std::atomic<size_t> found{count};
+    pool.parallel_for(count, [&](size_t idx, size_t worker) {
+        if (idx >= found.load(std::memory_order_relaxed))
+            return;
+        auto noun = nouns.first + value_t(idx / verbs.size());
+        auto verb = verbs.first + value_t(idx % verbs.size());
+        if (compute(vms[worker], noun, verb) != target)
+            return;
+        auto prev = found.load(std::memory_order_relaxed);
+        while (idx < prev && !found.compare_exchange_weak(prev, idx, std::memory_order_relaxed)) {}
+    }, verbs.size());
+
+    if (found == count)
+        return std::nullopt;
+    return std::make_pair(nouns.first + value_t(found / verbs.size()), verbs.first + value_t(found % verbs.size()));
 }
 
-static inline memory_value_t compute(const struct computer_state& state,
-                                     memory_value_t noun,
-                                     memory_value_t verb) {
-    struct computer_state copy_state = state;
-    copy_state.memory[1] = noun;
-    copy_state.memory[2] = verb;
-    execute_program(copy_state);
-    return copy_state.memory[0];
+/* memory[0] is usually affine in noun and verb, in which case there is nothing to search */
+static inline std::optional<std::pair<value_t, value_t>> solve_inputs(const aoc::computer& computer,
+                                                                      search_range nouns, search_range verbs, value_t target) {
+    aoc::symbolic_computer sc(computer);
+    sc.make_symbol(1, "noun");
+    sc.make_symbol(2, "verb");
+    auto r = sc.run();
+    if (r.status != aoc::symbolic_computer::SR_HALTED) {
+        if constexpr (DEBUG)
+            fmt::print(::stderr, "symbolic run failed: {}\n", sc.describe(r));
+        return std::nullopt;
+    }
+    if constexpr (DEBUG)
+        fmt::print(::stderr, "memory[0] = {}\n", sc.to_string(sc.cell(0)));
+    if (auto values = sc.solve(sc.cell(0), target, {{nouns.first, nouns.last}, {verbs.first, verbs.last}}))
+        return std::make_pair((*values)[0], (*values)[1]);
+    return std::nullopt;
 }
 
 int main() {
     if constexpr (DEBUG) {
-        auto test = [](const std::vector<memory_value_t>& memory) {
-            computer_state state{memory, 0};
-            execute_program(state);
-            fmt::print("{}\n", state.memory);
+        auto test = [](std::string_view code) {
+            aoc::computer computer;
+            computer.add_memory_values(code);
+            computer.execute();
+            fmt::print("{}\n", computer.memory().to_vector());
         };
-        test({1, 0, 0, 0, 99});
-        test({2, 3, 0, 3, 99});
-        test({2, 4, 4, 5, 99, 0});
-        test({1, 1, 1, 4, 99, 5, 6, 0, 99});
+        test("1,0,0,0,99");
+        test("2,3,0,3,99");
+        test("2,4,4,5,99,0");
+        test("1,1,1,4,99,5,6,0,99");
     }
 
-    auto state = read_initial_state();
+    auto computer = aoc::computer::read_initial_state();
 
-    fmt::print("{}\n", compute(state, 12, 2));
+    auto vm = computer.fork();
+    vm.set_baseline();
+    fmt::print("{}\n", compute(vm, 12, 2));
 
-    for (memory_value_t noun = 0; noun < 100; noun++) {
-        for (memory_value_t verb = 0; verb < 100; verb++) {
-            if (compute(state, noun, verb) == 19690720) {
-                fmt::print("{}\n", 100 * noun + verb);
-                return 0;
-            }
+    auto inputs = solve_inputs(computer, {0, 99}, {0, 99}, 19690720);
+    /* DEBUG builds search even when the symbolic run solved it, and both have to agree */
+    if (!inputs || DEBUG) {
+        aoc::thread_pool pool{};
+        auto searched = find_inputs(pool, computer, {0, 99}, {0, 99}, 19690720);
+        if (inputs && searched != inputs) {
+            fmt::print(::stderr, "SOLVED INPUTS {} DIFFER FROM SEARCHED ONES {}\n", *inputs,
+                       searched ? fmt::format("{}", *searched) : "(none)");
+            std::abort();
         }
+        inputs = searched;
     }
+    if (inputs)
+        fmt::print("{}\n", 100 * inputs->first + inputs->second);
 
     return 0;
 }
@@ -1,4 +1,5 @@
-#include <computer.h>
+#include <computer_aot.h>
+#include <thread_pool.h>
 #include <queue>
 
 using int_type = aoc::computer::memory_value_t;
@@ -44,11 +45,11 @@ struct packet {
     }
 };
 
-static inline void run_network(const aoc::computer& nic) {
+/* returns the first Y sent to the NAT and the first Y it delivers twice in a row */
+static inline auto run_network(const aoc::computer& nic) {
     for (int_type addr = 0; addr < int_type(computers.size()); addr++) {
         auto& c = computers.at(addr);
-        c = nic;
-        c.expand_memory(32 * 1024);
+        c = nic.fork();
         c.set_default_input(-1);
         c.add_input(addr);
     }
@@ -57,15 +58,15 @@ static inline void run_network(const aoc::computer& nic) {
     std::queue<packet> queue{};
     packet nat{};
     packet last_nat{};
-    bool part1_done{false};
-    bool part2_done{false};
+    std::optional<int_type> part1{};
+    std::optional<int_type> part2{};
 
-    while (!part1_done || !part2_done) {
+    while (!part1 || !part2) {
         int_type writes{0};
 
         for (int_type src = 0; src < int_type(computers.size()); src++) {
             auto& c = computers.at(src);
-            c.single_step();
+            c.execute_until_blocked();
             if (c.outputs().size()) {
                 auto val = c.get_output().value();
                 auto& p = packets.at(src);
@@ -101,8 +102,7 @@ static inline void run_network(const aoc::computer& nic) {
             if (!nat.is_complete())
                 continue;
             if (last_nat.is_complete() && last_nat.y.value() == nat.y.value()) {
-                fmt::print("{}\n", nat.y.value());
-                part2_done = true;
+                part2 = nat.y.value();
                 continue;
             }
             computers.at(0).add_input({nat.x.value(), nat.y.value()});
@@ -117,22 +117,215 @@ static inline void run_network(const aoc::computer& nic) {
                     computers.at(dst).add_input({p.x.value(), p.y.value()});
                 } else {
                     assert(dst == 255);
-                    if (!part1_done) {
-                        fmt::print("{}\n", p.y.value());
-                        part1_done = true;
-                    }
+                    if (!part1)
+                        part1 = p.y.value();
                     nat = p;
                 }
                 queue.pop();
             }
         }
     }
+    return std::make_pair(part1.value(), part2.value());
+}
+
+/*
+ * Bounded multi-producer, single-consumer packet queue: every slot carries a sequence number telling
+ * producers whether it is free and the consumer whether it has been filled.
+ */
+class inbox {
+public:
+    static constexpr const size_t capacity = 256;
+
+    inbox() {
+        for (size_t idx = 0; idx < capacity; idx++)
+            slots_[idx].seq.store(idx, std::memory_order_relaxed);
+    }
+
+    bool try_push(int_type x, int_type y) {
+        auto pos = tail_.load(std::memory_order_relaxed);
+        while (true) {
+            auto& slot = slots_[pos & (capacity - 1)];
+            auto diff = intptr_t(slot.seq.load(std::memory_order_acquire)) - intptr_t(pos);
+            if (diff < 0)
+                return false;
+            if (diff > 0) {
+                pos = tail_.load(std::memory_order_relaxed);
+            } else if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.x = x;
+                slot.y = y;
+                slot.seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+    }
+
+    bool try_pop(int_type& x, int_type& y) {
+        auto& slot = slots_[head_ & (capacity - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != head_ + 1)
+            return false;
+        x = slot.x;
+        y = slot.y;
+        slot.seq.store(head_ + capacity, std::memory_order_release);
+        head_ += 1;
+        return true;
+    }
+
+private:
+    struct slot_t {
+        std::atomic<size_t> seq;
+        int_type x;
+        int_type y;
+    };
+
+    std::array<slot_t, capacity> slots_{};
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) size_t head_{0};
+};
+
+/*
+ * Every worker of the pool owns the NICs whose address is congruent to its index and keeps running each
+ * of them until it polls an empty queue. Packets go straight into the destination's inbox. A NIC counts
+ * as idle once it polled an empty queue `idle_polls` times in a row without sending or receiving;
+ * `activity` counts the NICs which are not idle plus packets which were sent but not picked up yet, so
+ * once it drops to 0 the network is idle and whichever worker notices first plays the NAT.
+ */
+static inline auto run_network_parallel(const aoc::computer& nic) {
+    static constexpr const unsigned idle_polls = 2;
+    static constexpr const size_t nic_count = computers.size();
+
+    struct nic_state {
+        aoc::computer vm;
+        std::vector<std::tuple<size_t, int_type, int_type>> pending{};
+        unsigned empty_polls{0};
+        bool idle{false};
+    };
+
+    std::vector<nic_state> nics{};
+    nics.reserve(nic_count);
+    for (size_t addr = 0; addr < nic_count; addr++) {
+        nics.push_back({nic.fork()});
+        nics.back().vm.set_default_input(-1);
+        nics.back().vm.add_input(addr);
+    }
+    std::vector<inbox> inboxes(nic_count);
+
+    std::atomic<size_t> activity{nic_count};
+    std::atomic<bool> done{false};
+    std::mutex nat_mutex{};
+    std::optional<std::pair<int_type, int_type>> nat{};
+    std::optional<int_type> last_nat_y{};
+    std::optional<int_type> part1{};
+    std::optional<int_type> part2{};
+
+    const auto send = [&](nic_state& src, int_type dst, int_type x, int_type y) {
+        if (dst == 255) {
+            std::lock_guard<std::mutex> lock(nat_mutex);
+            nat = std::make_pair(x, y);
+            if (!part1)
+                part1 = y;
+            return;
+        }
+        if (dst < 0 || size_t(dst) >= nic_count)
+            return;
+        activity.fetch_add(1, std::memory_order_acq_rel);
+        if (!inboxes[size_t(dst)].try_push(x, y))
+            src.pending.emplace_back(size_t(dst), x, y);
+    };
+
+    const auto wake_up_network = [&]() {
+        std::lock_guard<std::mutex> lock(nat_mutex);
+        if (activity.load(std::memory_order_acquire) || !nat)
+            return;
+        if (last_nat_y == nat->second) {
+            part2 = nat->second;
+            done.store(true, std::memory_order_release);
+            return;
+        }
+        last_nat_y = nat->second;
+        activity.fetch_add(1, std::memory_order_acq_rel);
+        inboxes[0].try_push(nat->first, nat->second);
+    };
+
+    aoc::thread_pool pool{};
+    pool.run([&](size_t worker) {
+        while (!done.load(std::memory_order_acquire)) {
+            for (auto addr = worker; addr < nic_count; addr += pool.size()) {
+                auto& n = nics[addr];
+                size_t received{0};
+                int_type x{};
+                int_type y{};
+                while (inboxes[addr].try_pop(x, y)) {
+                    n.vm.add_input({x, y});
+                    received += 1;
+                }
+                const auto wake_up = [&]() {
+                    if (n.idle) {
+                        n.idle = false;
+                        activity.fetch_add(1, std::memory_order_acq_rel);
+                    }
+                };
+                if (received) {
+                    wake_up();
+                    activity.fetch_sub(received, std::memory_order_acq_rel);
+                }
+
+                auto retry = std::move(n.pending);
+                n.pending.clear();
+                for (auto [dst, px, py] : retry) {
+                    if (!inboxes[dst].try_push(px, py))
+                        n.pending.emplace_back(dst, px, py);
+                }
+
+                bool sent{false};
+                while (true) {
+                    auto reason = n.vm.execute_until_blocked(3);
+                    while (n.vm.outputs().size() >= 3) {
+                        auto dst = n.vm.get_output().value();
+                        auto px = n.vm.get_output().value();
+                        auto py = n.vm.get_output().value();
+                        wake_up();
+                        send(n, dst, px, py);
+                        sent = true;
+                    }
+                    if (reason != aoc::computer::BR_OUTPUT)
+                        break;
+                }
+
+                if (received || sent || !n.pending.empty())
+                    n.empty_polls = 0;
+                else
+                    n.empty_polls += 1;
+                if (!n.idle && n.empty_polls >= idle_polls) {
+                    n.idle = true;
+                    activity.fetch_sub(1, std::memory_order_acq_rel);
+                }
+            }
+            if (!activity.load(std::memory_order_acquire))
+                wake_up_network();
+        }
+    });
+
+    return std::make_pair(part1.value(), part2.value());
 }
 
 int main() {
     auto nic = aoc::computer::read_initial_state();
+    aoc::enable_compiled_program(nic);
+
+    bool parallel{aoc::thread_pool::default_size() > 1};
+    auto [part1, part2] = parallel ? run_network_parallel(nic) : run_network(nic);
+    fmt::print("{}\n", part1);
+    fmt::print("{}\n", part2);
 
-    run_network(nic);
+    if constexpr (DEBUG) {
+        /* whichever engine this machine did not pick has to come to the same answers */
+        auto other = parallel ? run_network(nic) : run_network_parallel(nic);
+        if (other != std::make_pair(part1, part2)) {
+            fmt::print(::stderr, "{} NETWORK DIFFERS: {} {} vs {} {}\n", parallel ? "SEQUENTIAL" : "PARALLEL", other.first,
+                       other.second, part1, part2);
+            std::abort();
+        }
+    }
 
     return 0;
 }
@@ -1,5 +1,8 @@
 #include <aoc.h>
 #include <computer.h>
+#include <computer_analysis.h>
+#include <computer_ir.h>
+#include <computer_jit.h>
 
 int main() {
     if constexpr (DEBUG) {
@@ -21,6 +24,44 @@ int main() {
 
     auto computer = aoc::computer::read_initial_state();
 
+    if constexpr (DEBUG) {
+        /* the program patches the opcode right after its first ADD, so the analysis has to give up past it */
+        aoc::program_analysis analysis(computer);
+        analysis.report(stderr);
+        aoc::computer live(computer);
+        live.add_input(1);
+        while (analysis.is_instruction_start(size_t(live.instruction_pointer())))
+            live.single_step();
+        auto stop = size_t(live.instruction_pointer());
+        const auto& written = analysis.written_code();
+        if (!analysis.undecodable().count(stop) || std::find(written.begin(), written.end(), stop) == written.end() ||
+            !analysis.rewrites_opcodes() || analysis.highest_address() || analysis.fits(live.memory().size())) {
+            fmt::print(::stderr, "ANALYSIS MISSED THE PATCHED OPCODE AT {}\n", stop);
+            std::abort();
+        }
+
+        /* the same patch with every region compiled as soon as it is reached, by either back end */
+        const auto compare = [&computer](std::string_view name, auto enable) {
+            for (aoc::computer::memory_value_t in : {1, 5}) {
+                aoc::computer reference(computer), accelerated(computer);
+                enable(accelerated);
+                for (auto* c : {&reference, &accelerated}) {
+                    c->add_input(in);
+                    c->execute();
+                }
+                if (!std::equal(accelerated.outputs().begin(), accelerated.outputs().end(), reference.outputs().begin(),
+                                reference.outputs().end()) ||
+                    accelerated.instruction_pointer() != reference.instruction_pointer() ||
+                    accelerated.memory().to_vector() != reference.memory().to_vector()) {
+                    fmt::print(::stderr, "{} RUN OF PART {} DIFFERS\n", name, in == 1 ? 1 : 2);
+                    std::abort();
+                }
+            }
+        };
+        compare("JIT", [](aoc::computer& c) { aoc::enable_jit(c, 1); });
+        compare("IR", [](aoc::computer& c) { aoc::enable_ir(c, 1); });
+    }
+
     const auto run_test = [](const aoc::computer& src, auto in) {
         aoc::computer c(src);
         c.add_input(in);
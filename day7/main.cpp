@@ -1,67 +1,145 @@
-#include <computer.h>
+#include <computer_coro.h>
+#include <thread_pool.h>
 
-using phase_setting_array = std::array<aoc::computer::memory_value_t, 5>;
+using value_t = aoc::computer::memory_value_t;
 
-static inline auto part1(const aoc::computer& computer) {
-    phase_setting_array phase_settings{0, 1, 2, 3, 4};
-    aoc::computer::memory_value_t ret = std::numeric_limits<aoc::computer::memory_value_t>::min();
+/* one set of amplifiers per worker, rewound between permutations instead of forked anew */
+struct amplifier_set {
+    amplifier_set(const aoc::computer& computer, size_t count) {
+        for (size_t idx = 0; idx < count; idx++) {
+            amplifiers.push_back(computer.fork());
+            amplifiers.back().set_baseline();
+        }
+    }
 
-    do {
-        aoc::computer A(computer);
-        aoc::computer B(computer);
-        aoc::computer C(computer);
-        aoc::computer D(computer);
-        aoc::computer E(computer);
+    std::vector<aoc::computer> amplifiers{};
+    value_t best{std::numeric_limits<value_t>::min()};
+};
 
-        A.add_input({phase_settings[0], aoc::computer::memory_value_t(0)}); A.execute();
-        B.add_input({phase_settings[1], A.outputs().back()}); B.execute();
-        C.add_input({phase_settings[2], B.outputs().back()}); C.execute();
-        D.add_input({phase_settings[3], C.outputs().back()}); D.execute();
-        E.add_input({phase_settings[4], D.outputs().back()}); E.execute();
+/* phase settings of permutation number `idx` out of all ordered picks of `count` values from `phases` */
+static inline auto nth_permutation(std::vector<value_t> phases, size_t count, size_t idx) {
+    std::vector<value_t> ret{};
+    for (size_t pos = 0; pos < count; pos++) {
+        auto pick = idx % phases.size();
+        idx /= phases.size();
+        ret.push_back(phases[pick]);
+        phases.erase(phases.begin() + ptrdiff_t(pick));
+    }
+    return ret;
+}
 
-        ret = std::max(ret, E.outputs().back());
-    } while (std::next_permutation(std::begin(phase_settings), std::end(phase_settings)));
+/* runs one amplifier per phase setting, wired into a chain or a feedback ring, and returns the thrust */
+static inline auto amplify(std::vector<aoc::computer>& amplifiers, const std::vector<value_t>& phase_settings, aoc::pipeline::topology shape) {
+    for (size_t idx = 0; idx < amplifiers.size(); idx++) {
+        amplifiers[idx].reset_to_baseline();
+        amplifiers[idx].add_input(phase_settings[idx]);
+    }
 
-    return ret;
+    aoc::pipeline p(amplifiers, shape);
+    p.input().try_push(0);
+    p.run();
+    return p.output().last().value();
+}
+
+/* highest thrust over every way of giving `count` amplifiers distinct phases from [first_phase, last_phase] */
+static inline auto max_thrust(aoc::thread_pool& pool, const aoc::computer& computer, size_t count,
+                              value_t first_phase, value_t last_phase, aoc::pipeline::topology shape) {
+    std::vector<value_t> phases(size_t(last_phase - first_phase + 1));
+    std::iota(phases.begin(), phases.end(), first_phase);
+    if (count > phases.size()) {
+        fmt::print(::stderr, "NOT ENOUGH PHASES ({}) FOR {} AMPLIFIERS\n", phases.size(), count);
+        std::abort();
+    }
+
+    size_t permutations{1};
+    for (size_t pos = 0; pos < count; pos++)
+        permutations *= phases.size() - pos;
+
+    std::vector<amplifier_set> sets{};
+    for (size_t idx = 0; idx < pool.size(); idx++)
+        sets.emplace_back(computer, count);
+
+    pool.parallel_for(permutations, [&](size_t idx, size_t worker) {
+        auto& set = sets[worker];
+        set.best = std::max(set.best, amplify(set.amplifiers, nth_permutation(phases, count, idx), shape));
+    }, 4);
+
+    return std::max_element(sets.begin(), sets.end(), [](const auto& a, const auto& b) { return a.best < b.best; })->best;
 }
 
-static inline auto part2(const aoc::computer& computer) {
-    phase_setting_array phase_settings{5, 6, 7, 8, 9};
-    aoc::computer::memory_value_t ret = std::numeric_limits<aoc::computer::memory_value_t>::min();
-    std::set<aoc::computer::instruction_code> p_ops{aoc::computer::OP_OUT};
-
-    do {
-        aoc::computer A(computer); A.add_input(phase_settings[0]);
-        aoc::computer B(computer); B.add_input(phase_settings[1]);
-        aoc::computer C(computer); C.add_input(phase_settings[2]);
-        aoc::computer D(computer); D.add_input(phase_settings[3]);
-        aoc::computer E(computer); E.add_input(phase_settings[4]);
-
-        aoc::computer::memory_value_t in_A{0};
-        aoc::computer::memory_value_t in_B{0};
-        aoc::computer::memory_value_t in_C{0};
-        aoc::computer::memory_value_t in_D{0};
-        aoc::computer::memory_value_t in_E{0};
-
-        while (!E.is_halted()) {
-            A.add_input(in_A); A.execute_with_pause(p_ops); in_B = A.outputs().back();
-            B.add_input(in_B); B.execute_with_pause(p_ops); in_C = B.outputs().back();
-            C.add_input(in_C); C.execute_with_pause(p_ops); in_D = C.outputs().back();
-            D.add_input(in_D); D.execute_with_pause(p_ops); in_E = D.outputs().back();
-            E.add_input(in_E); E.execute_with_pause(p_ops); in_A = E.outputs().back();
+/*
+ * amplify() again, but with every amplifier executing on a thread of its own behind blocking I/O while this
+ * thread carries each output over to the next amplifier's input
+ */
+static inline auto amplify_threaded(const aoc::computer& computer, const std::vector<value_t>& phase_settings,
+                                    aoc::pipeline::topology shape) {
+    std::vector<aoc::computer> amplifiers(phase_settings.size(), computer);
+    for (size_t idx = 0; idx < amplifiers.size(); idx++) {
+        amplifiers[idx].set_blocking_io(true);
+        amplifiers[idx].push_input(phase_settings[idx]);
+    }
+    amplifiers[0].push_input(0);
+
+    std::vector<std::thread> threads{};
+    for (auto& amplifier : amplifiers)
+        threads.emplace_back([&amplifier] { amplifier.execute(); });
+
+    value_t thrust{};
+    for (bool running = true; running;) {
+        running = false;
+        for (size_t idx = 0; idx < amplifiers.size(); idx++) {
+            /* anything put out before halting is there to drain once the halt is seen */
+            bool halted = amplifiers[idx].is_halted();
+            while (auto v = amplifiers[idx].get_output()) {
+                if (idx + 1 == amplifiers.size())
+                    thrust = *v;
+                if (idx + 1 < amplifiers.size() || shape == aoc::pipeline::ring) {
+                    while (!amplifiers[(idx + 1) % amplifiers.size()].push_input(*v))
+                        std::this_thread::yield();
+                }
+            }
+            running = running || !halted;
         }
+        std::this_thread::yield();
+    }
+    for (auto& thread : threads)
+        thread.join();
+    return thrust;
+}
 
-        ret = std::max(ret, E.outputs().back());
-    } while (std::next_permutation(std::begin(phase_settings), std::end(phase_settings)));
+static inline auto part1(aoc::thread_pool& pool, const aoc::computer& computer) {
+    return max_thrust(pool, computer, 5, 0, 4, aoc::pipeline::chain);
+}
 
-    return ret;
+static inline auto part2(aoc::thread_pool& pool, const aoc::computer& computer) {
+    return max_thrust(pool, computer, 5, 5, 9, aoc::pipeline::ring);
 }
 
 int main() {
     auto computer = aoc::computer::read_initial_state();
+    aoc::thread_pool pool{};
+
+    auto thrust1 = part1(pool, computer);
+    auto thrust2 = part2(pool, computer);
+    fmt::print("{}\n", thrust1);
+    fmt::print("{}\n", thrust2);
 
-    fmt::print("{}\n", part1(computer));
-    fmt::print("{}\n", part2(computer));
+    if constexpr (DEBUG) {
+        /* both parts again from amplifiers on threads of their own */
+        const auto check = [&computer](value_t first_phase, aoc::pipeline::topology shape, value_t expected) {
+            std::vector<value_t> phases(5);
+            std::iota(phases.begin(), phases.end(), first_phase);
+            value_t best{std::numeric_limits<value_t>::min()};
+            for (size_t idx = 0; idx < 5 * 4 * 3 * 2; idx++)
+                best = std::max(best, amplify_threaded(computer, nth_permutation(phases, 5, idx), shape));
+            if (best != expected) {
+                fmt::print(::stderr, "THREADED AMPLIFIERS DIFFER: {} vs {}\n", best, expected);
+                std::abort();
+            }
+        };
+        check(0, aoc::pipeline::chain, thrust1);
+        check(5, aoc::pipeline::ring, thrust2);
+    }
 
     return 0;
 }
@@ -1,11 +1,234 @@
-#include <computer.h>
+#include <computer_analysis.h>
+#include <computer_ir.h>
+#include <computer_jit.h>
+#include <computer_trace.h>
+
+#include <filesystem>
+
+using value_t = aoc::computer::memory_value_t;
+
+/* what runs the hot loops of both parts; DEBUG builds check the IR against the plain interpreter */
+enum back_end { BE_INTERPRETER, BE_JIT, BE_IR };
+static constexpr const back_end use_back_end = BE_JIT;
+
+static inline void accelerate(aoc::computer& c, back_end be, std::optional<uint32_t> hot_threshold = std::nullopt) {
+    switch (be) {
+        case BE_INTERPRETER: break;
+        case BE_JIT: hot_threshold ? aoc::enable_jit(c, *hot_threshold) : aoc::enable_jit(c); break;
+        case BE_IR: hot_threshold ? aoc::enable_ir(c, *hot_threshold) : aoc::enable_ir(c); break;
+    }
+}
+
+template <typename policy = aoc::checked_policy>
+static inline auto load(const std::string& source) {
+    std::istringstream in(source);
+    return aoc::basic_computer<policy>::read_initial_state(in);
+}
+
+static inline void check(bool ok, std::string_view what) {
+    if (!ok) {
+        fmt::print(::stderr, "{} DIFFERS\n", what);
+        std::abort();
+    }
+}
+
+/* runs the program on the smallest of the unchecked computers the analysis shows it fits, if any */
+template <size_t words, size_t... larger>
+static inline std::optional<std::vector<value_t>> run_unchecked(const aoc::program_analysis& analysis, const std::string& source,
+                                                                std::optional<value_t> in) {
+    if (analysis.fits(words)) {
+        auto c = load<aoc::unchecked_policy<words>>(source);
+        if (in) c.add_input(*in);
+        c.execute();
+        return std::vector<value_t>(c.outputs().begin(), c.outputs().end());
+    }
+    if constexpr (sizeof...(larger) > 0)
+        return run_unchecked<larger...>(analysis, source, in);
+    else
+        return std::nullopt;
+}
+static inline auto run_unchecked(const aoc::program_analysis& analysis, const std::string& source, std::optional<value_t> in) {
+    return run_unchecked<size_t(1) << 10, size_t(1) << 16>(analysis, source, in);
+}
+
+/* how many instructions the program runs for input `in`, HLT included */
+static inline uint64_t count_instructions(const std::string& source, value_t in) {
+    auto c = load(source);
+    c.add_input(in);
+    uint64_t count{0};
+    for (; !c.is_halted(); count++)
+        c.single_step();
+    return count;
+}
+
+/* the profile of part 2 has to account for every instruction it runs, one of them the HLT */
+static inline void check_profiler(const std::string& source, value_t coordinates, uint64_t instructions) {
+    auto profiled = load<aoc::profiling_policy>(source);
+    profiled.add_input(2);
+    profiled.execute();
+    profiled.profile().report(stderr, 5);
+    uint64_t counted{0};
+    for (size_t code = 0; code < aoc::execution_profile::max_opcode; code++)
+        counted += profiled.profile().executions(code);
+    check(profiled.outputs().back() == coordinates && counted == instructions &&
+          profiled.profile().executions(aoc::computer::OP_HLT) == 1, "PROFILED RUN");
+
+    /* the mode digits OUT has no parameters for are not part of its combination */
+    aoc::basic_computer<aoc::profiling_policy> stray;
+    stray.add_memory_values("30104,7,99");
+    stray.execute();
+    std::ostringstream csv{};
+    stray.profile().write_csv(csv);
+    check(stray.outputs().back() == 7 && stray.profile().executions(aoc::computer::OP_OUT) == 1 &&
+          csv.str().find("modes,OUT IPP,1,") != std::string::npos, "STRAY MODE DIGITS");
+}
+
+/* without the timer part 2 gets a sample every `period` instructions exactly */
+static inline void check_sampler(const std::string& source, value_t coordinates, uint64_t instructions) {
+    constexpr uint64_t period = 97;
+    auto sampled = load<aoc::sampling_policy>(source);
+    sampled.sampler().every(period);
+    sampled.add_input(2);
+    sampled.execute();
+    sampled.sampler().report(stderr, 5);
+    std::ostringstream folded{};
+    sampled.sampler().write_folded(folded);
+    check(sampled.outputs().back() == coordinates && sampled.sampler().samples() == instructions / period && !folded.str().empty(),
+          "SAMPLED RUN");
+}
+
+/* both parts recorded; part 2's trace halfway through has to be where a live computer is after as many steps */
+static inline void check_trace(const std::string& source, value_t coordinates, uint64_t instructions) {
+    const auto record = [&source](value_t in, const std::filesystem::path& path) {
+        auto recorded = load<aoc::recording_policy>(source);
+        recorded.start_trace(path);
+        recorded.add_input(in);
+        recorded.execute();
+        recorded.stop_trace();
+        return recorded.outputs().back();
+    };
+    auto keycode_path = std::filesystem::temp_directory_path() / "day9_part1.trace";
+    auto coordinates_path = std::filesystem::temp_directory_path() / "day9_part2.trace";
+    record(1, keycode_path);
+    check(record(2, coordinates_path) == coordinates, "RECORDED RUN");
+    {
+        aoc::trace_replay keycode_trace(keycode_path), coordinates_trace(coordinates_path);
+        check(coordinates_trace.instructions() == instructions, "TRACE LENGTH");
+
+        auto live = load(source);
+        live.add_input(2);
+        for (uint64_t step = 0; step < instructions / 2; step++)
+            live.single_step();
+        auto halfway = coordinates_trace.at(instructions / 2);
+        bool same{halfway.ip == live.instruction_pointer() && halfway.relbase == live.relative_base()};
+        for (size_t addr = 0; addr < std::max(halfway.memory.size(), live.memory().size()); addr++)
+            same = same && live.memory().read(value_t(addr)) == (addr < halfway.memory.size() ? halfway.memory[addr] : 0);
+        check(same, "REPLAYED STATE");
+
+        /* the two parts only part ways at the IN which reads the mode */
+        auto first_in = load(source);
+        uint64_t in_at{0};
+        for (; first_in.memory().read(first_in.instruction_pointer()) % 100 != aoc::computer::OP_IN; in_at++)
+            first_in.single_step();
+        check(aoc::trace_replay::first_difference(keycode_trace, coordinates_trace) == in_at &&
+              !aoc::trace_replay::first_difference(coordinates_trace, coordinates_trace), "FIRST DIFFERENCE");
+    }
+    std::filesystem::remove(keycode_path);
+    std::filesystem::remove(coordinates_path);
+}
+
+/* nothing in the program patches itself, so every instruction part 1 runs has to have been found statically */
+static inline void check_analysis(const aoc::computer& computer) {
+    aoc::program_analysis analysis(computer);
+    analysis.report(stderr);
+    check(analysis.written_code().empty() && analysis.undecodable().empty() && analysis.invalid_exits().empty(), "ANALYSIS");
+    aoc::computer live(computer);
+    live.add_input(1);
+    while (!live.is_halted()) {
+        check(analysis.is_instruction_start(size_t(live.instruction_pointer())), "DISCOVERED CODE");
+        live.single_step();
+    }
+}
+
+/*
+ * A call and its return fit below the top of the stack; a jump through a word nothing showed to hold a code
+ * pointer, or an access below address 0, leaves the highest address unknown.
+ */
+static inline void check_bounds() {
+    using image = std::vector<value_t>;
+    aoc::program_analysis call(image{109, 100, 21101, 9, 0, 0, 1105, 1, 11, 99, 0, 109, 1, 204, 0, 109, -1, 2105, 1, 0});
+    aoc::program_analysis jump(image{105, 1, 4, 99, 3});
+    aoc::program_analysis negative(image{4, -1, 204, -1, 99});
+    check(call.highest_address() == 101 && call.fits(102) && !call.fits(101) && jump.unresolved_jumps().size() == 1 &&
+          !jump.highest_address() && negative.negative_accesses().size() == 2 && !negative.highest_address(), "ANALYSIS BOUNDS");
+}
+
+/* whatever runs unchecked has to put out what a checked computer does */
+static inline void check_unchecked(const std::string& source, std::optional<value_t> in, bool has_to_fit) {
+    auto checked = load(source);
+    auto outputs = run_unchecked(aoc::program_analysis(checked), source, in);
+    if (in) checked.add_input(*in);
+    checked.execute();
+    check(outputs ? std::equal(outputs->begin(), outputs->end(), checked.outputs().begin(), checked.outputs().end()) : !has_to_fit,
+          "UNCHECKED RUN");
+}
+
+/* with every region lowered as soon as it is reached, `be` has to leave the computer exactly where the interpreter does */
+static inline void check_back_end(const aoc::computer& computer, back_end be, std::optional<value_t> in, std::string_view what) {
+    aoc::computer reference(computer);
+    if (in) reference.add_input(*in);
+    reference.execute();
+    aoc::computer c(computer);
+    accelerate(c, be, 1);
+    if (in) c.add_input(*in);
+    c.execute();
+    check(std::equal(c.outputs().begin(), c.outputs().end(), reference.outputs().begin(), reference.outputs().end()) &&
+          c.is_halted() && c.instruction_pointer() == reference.instruction_pointer() &&
+          c.relative_base() == reference.relative_base() && c.memory().to_vector() == reference.memory().to_vector(),
+          what);
+}
+
+/*
+ * A loop whose ADD gets its immediate operand bumped on every pass and, ten passes before the end, its opcode
+ * patched into a MUL; code the back end already compiled has to be dropped both times.
+ */
+static inline void check_self_patching(back_end be) {
+    aoc::computer patching;
+    patching.add_memory_values("1001,31,5,31,1001,2,1,2,1001,32,-1,32,1008,32,10,33,1006,33,23,1101,1002,0,0,"
+                               "1005,32,0,4,31,4,2,99,0,20,0");
+    check_back_end(patching, be, std::nullopt, "SELF-PATCHING RUN");
+}
+
+/* part 2 has to come out the same with its pairs fused; nothing patches itself, so no fused pair may have been missed */
+static inline void check_fusions(const std::string& source, value_t coordinates) {
+    auto counted = load<aoc::counting_policy>(source);
+    counted.add_input(2);
+    counted.execute();
+    counted.fusions().report(stderr);
+    uint64_t fired{0}, missed{0};
+    for (size_t si = 0; si < aoc::fusion_counters::SI_MAX_; si++) {
+        fired += counted.fusions().fired(si);
+        missed += counted.fusions().missed(si);
+    }
+    check(counted.outputs().back() == coordinates && fired > 0 && missed == 0, "FUSED RUN");
+
+    /* the ADD fused with the JNZ after it rewrites that JNZ into a JZ, so the pair has to fall apart and print 1 */
+    constexpr std::string_view patching{"1001,4,1,4,1005,0,9,104,1,99,104,2,99"};
+    auto fused = load<aoc::counting_policy>(std::string(patching));
+    fused.execute();
+    auto plain = load(std::string(patching));
+    plain.execute();
+    check(std::equal(fused.outputs().begin(), fused.outputs().end(), plain.outputs().begin(), plain.outputs().end()) &&
+          fused.outputs().size() == 1 && fused.outputs().back() == 1 &&
+          fused.fusions().fired(aoc::fusion_counters::SI_ADD_JNZ) == 0 &&
+          fused.fusions().missed(aoc::fusion_counters::SI_ADD_JNZ) == 1, "FUSED SELF-PATCH");
+}
 
 int main() {
     if constexpr (DEBUG) {
-        const auto test = [](std::string_view code, const std::vector<aoc::computer::memory_value_t>& inputs = {}, size_t mem_size = 1024) {
+        const auto test = [](std::string_view code, const std::vector<aoc::computer::memory_value_t>& inputs = {}) {
             aoc::computer computer;
             computer.add_memory_values(code);
-            computer.expand_memory(mem_size);
             for (auto v : inputs) computer.add_input(v);
             computer.execute();
             fmt::print("<< {}\n", computer.outputs());
@@ -15,20 +238,57 @@ int main() {
         test("109,1,204,-1,1001,100,1,100,1008,100,16,101,1006,101,0,99");
         test("1102,34915192,34915192,7,4,7,99,0");
         test("104,1125899906842624,99");
+
+        /* the first one again, with every instruction it runs printed to stderr */
+        aoc::basic_computer<aoc::tracing_policy> traced;
+        traced.add_memory_values("109,1,204,-1,99");
+        traced.execute();
+        fmt::print("<< {}\n", traced.outputs());
     }
 
-    auto computer = aoc::computer::read_initial_state();
+    std::string source(std::istreambuf_iterator<char>(std::cin), {});
+    auto computer = load(source);
+    aoc::program_analysis analysis(computer);
 
-    const auto run_test = [](const aoc::computer& src, aoc::computer::memory_value_t in, size_t mem_size = 32 * 1024) {
+    /* unchecked if the analysis bounds every address the program touches, accelerated otherwise */
+    const auto run_test = [&analysis, &source](const aoc::computer& src, value_t in) {
+        if (auto outputs = run_unchecked(analysis, source, in)) {
+            fmt::print("{}\n", outputs->back());
+            return outputs->back();
+        }
         aoc::computer c(src);
-        c.expand_memory(mem_size);
+        accelerate(c, use_back_end);
         c.add_input(in);
         c.execute();
         fmt::print("{}\n", c.outputs().back());
+        return c.outputs().back();
     };
 
     run_test(computer, 1);
-    run_test(computer, 2);
+    auto coordinates = run_test(computer, 2);
+
+    if constexpr (DEBUG) {
+        auto instructions = count_instructions(source, 2);
+        check_profiler(source, coordinates, instructions);
+        check_sampler(source, coordinates, instructions);
+        check_trace(source, coordinates, instructions);
+        check_analysis(computer);
+        check_bounds();
+        /* the quine moves its relative base on every pass, which is as good as recursion to the analysis */
+        for (auto program : {"109,1,204,-1,99", "1102,34915192,34915192,7,4,7,99,0", "104,1125899906842624,99",
+                             "109,100,21101,9,0,0,1105,1,11,99,0,109,1,204,0,109,-1,2105,1,0"})
+            check_unchecked(program, std::nullopt, true);
+        check_unchecked("109,1,204,-1,1001,100,1,100,1008,100,16,101,1006,101,0,99", std::nullopt, false);
+        for (value_t in : {1, 2})
+            check_unchecked(source, in, false);
+        for (value_t in : {1, 2})
+            check_back_end(computer, BE_IR, in, "IR RUN");
+        for (value_t in : {1, 2})
+            check_back_end(computer, BE_JIT, in, "JIT RUN");
+        check_self_patching(BE_JIT);
+        check_self_patching(BE_IR);
+        check_fusions(source, coordinates);
+    }
 
     return 0;
 }
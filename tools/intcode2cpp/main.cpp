@@ -0,0 +1,405 @@
+#include <computer.h>
+#include <fstream>
+
+/*
+ * intcode2cpp <image> <output.cpp>
+ *
+ * Disassembles an Intcode image starting at address 0 (following immediate jump targets, the
+ * fallthrough of conditional jumps and anything that looks like a code pointer) and writes a
+ * translation unit implementing aoc::make_compiled_program() for it (see computer_aot.h). Every basic
+ * block becomes straight-line C++, direct jumps become gotos and only indirect jumps go through a
+ * jump table keyed on IP.
+ */
+
+using memory_value_t = aoc::computer::memory_value_t;
+
+struct instruction {
+    size_t addr;
+    aoc::computer::instruction_code code;
+    size_t length;
+    std::array<aoc::computer::addressing_mode, 3> modes;
+    std::array<memory_value_t, 3> params;
+
+    inline bool is_jump() const {
+        return code == aoc::computer::OP_JNZ || code == aoc::computer::OP_JZ;
+    }
+    inline bool is_compilable() const {
+        switch (code) {
+            case aoc::computer::OP_ADD: [[fallthrough]];
+            case aoc::computer::OP_MUL: [[fallthrough]];
+            case aoc::computer::OP_LT: [[fallthrough]];
+            case aoc::computer::OP_EQ: return modes[2] != aoc::computer::AM_IMMEDIATE;
+            case aoc::computer::OP_JNZ: [[fallthrough]];
+            case aoc::computer::OP_JZ: [[fallthrough]];
+            case aoc::computer::OP_SRB: return true;
+            default: return false;
+        }
+    }
+};
+
+struct block {
+    size_t start;
+    size_t end;
+    std::vector<instruction> body;
+    size_t next;
+};
+
+class disassembler {
+public:
+    explicit disassembler(std::vector<memory_value_t> image) : image_(std::move(image)) {}
+
+    std::optional<instruction> decode(size_t addr) const {
+        static constexpr const size_t lengths[] = {0, 4, 4, 2, 2, 3, 3, 4, 4, 2};
+        if (addr >= image_.size() || image_[addr] < 0)
+            return std::nullopt;
+        auto raw = image_[addr];
+        auto code = raw % 100;
+        size_t length{0};
+        if (code == aoc::computer::OP_HLT)
+            length = 1;
+        else if (code > 0 && code < memory_value_t(std::size(lengths)))
+            length = lengths[code];
+        if (!length || addr + length > image_.size())
+            return std::nullopt;
+
+        instruction ret{addr, aoc::computer::instruction_code(code), length, {}, {}};
+        auto modes = raw / 100;
+        for (size_t p = 0; p + 1 < length; p++) {
+            if (modes % 10 >= aoc::computer::AM_MAX_)
+                return std::nullopt;
+            ret.modes[p] = aoc::computer::addressing_mode(modes % 10);
+            ret.params[p] = image_[addr + 1 + p];
+            modes /= 10;
+        }
+        return ret;
+    }
+
+    void run() {
+        std::set<size_t> pointers{};
+        add_leader(0);
+        while (true) {
+            while (!pending_.empty()) {
+                auto addr = *pending_.begin();
+                pending_.erase(pending_.begin());
+                explore(addr, pointers);
+            }
+            bool added{false};
+            for (auto p : pointers) {
+                if (!leaders_.count(p) && is_plausible_entry(p)) {
+                    add_leader(p);
+                    added = true;
+                }
+            }
+            pointers.clear();
+            if (!added)
+                break;
+        }
+    }
+
+    std::vector<block> blocks() const {
+        std::vector<block> ret{};
+        for (auto leader : leaders_) {
+            block b{leader, leader, {}, 0};
+            auto addr = leader;
+            while (true) {
+                auto ins = decode(addr);
+                if (!ins || !ins->is_compilable())
+                    break;
+                b.body.push_back(*ins);
+                addr += ins->length;
+                if (ins->is_jump() || leaders_.count(addr))
+                    break;
+            }
+            if (b.body.empty())
+                continue;
+            b.end = addr;
+            b.next = addr;
+            ret.push_back(std::move(b));
+        }
+        return ret;
+    }
+
+    const auto& image() const {
+        return image_;
+    }
+
+private:
+    inline void add_leader(size_t addr) {
+        if (addr < image_.size() && leaders_.insert(addr).second)
+            pending_.insert(addr);
+    }
+
+    void explore(size_t addr, std::set<size_t>& pointers) {
+        while (auto ins = decode(addr)) {
+            auto next = addr + ins->length;
+            switch (ins->code) {
+                case aoc::computer::OP_JNZ: [[fallthrough]];
+                case aoc::computer::OP_JZ: {
+                    if (ins->modes[1] == aoc::computer::AM_IMMEDIATE && ins->params[1] >= 0)
+                        add_leader(size_t(ins->params[1]));
+                    add_leader(next);
+                    return;
+                }
+                case aoc::computer::OP_IN: [[fallthrough]];
+                case aoc::computer::OP_OUT: {
+                    add_leader(next);
+                    return;
+                }
+                case aoc::computer::OP_HLT: return;
+                default: break;
+            }
+            /* return addresses get pushed as immediates */
+            for (size_t p = 0; p + 1 < ins->length; p++) {
+                if (ins->modes[p] == aoc::computer::AM_IMMEDIATE && ins->params[p] >= 0 && size_t(ins->params[p]) < image_.size())
+                    pointers.insert(size_t(ins->params[p]));
+            }
+            if (!ins->is_compilable())
+                return;
+            addr = next;
+        }
+    }
+
+    /* a code pointer candidate has to decode cleanly up to the first control transfer */
+    bool is_plausible_entry(size_t addr) const {
+        while (auto ins = decode(addr)) {
+            if (ins->is_jump() || ins->code == aoc::computer::OP_HLT)
+                return true;
+            addr += ins->length;
+        }
+        return false;
+    }
+
+    std::vector<memory_value_t> image_;
+    std::set<size_t> leaders_{};
+    std::set<size_t> pending_{};
+};
+
+class emitter {
+public:
+    emitter(const disassembler& dis, std::string_view source) : dis_(dis), source_(source) {}
+
+    std::string generate() {
+        auto blocks = dis_.blocks();
+        std::map<size_t, size_t> block_at{};
+        for (size_t idx = 0; idx < blocks.size(); idx++)
+            block_at[blocks[idx].start] = idx;
+
+        line("/* generated by intcode2cpp from {}, do not edit */", source_);
+        line("#include <computer_aot.h>");
+        line("");
+        line("#define AOC_LEAVE(at) do {{ ip = (at); return; }} while (0)");
+        line("");
+        line("namespace {{");
+        line("    using memory_value_t = aoc::computer::memory_value_t;");
+        line("");
+        line("    constexpr const memory_value_t image[] = {{");
+        const auto& image = dis_.image();
+        for (size_t idx = 0; idx < image.size(); idx += 16) {
+            std::string buff{};
+            for (size_t col = idx; col < std::min(image.size(), idx + 16); col++)
+                buff += fmt::format("{},", literal(image[col]));
+            line("        {}", buff);
+        }
+        line("    }};");
+        line("");
+        std::vector<uint8_t> code_words(image.size(), 0);
+        for (const auto& b : blocks)
+            std::fill(code_words.begin() + ptrdiff_t(b.start), code_words.begin() + ptrdiff_t(b.end), 1);
+        line("    constexpr const uint8_t code_words[] = {{");
+        for (size_t idx = 0; idx < code_words.size(); idx += 32) {
+            std::string buff{};
+            for (size_t col = idx; col < std::min(code_words.size(), idx + 32); col++)
+                buff += fmt::format("{},", code_words[col]);
+            line("        {}", buff);
+        }
+        line("    }};");
+        line("");
+        line("    constexpr const aoc::compiled_program::block_t blocks[] = {{");
+        for (const auto& b : blocks)
+            line("        {{{}, {}}},", b.start, b.end);
+        if (blocks.empty())
+            line("        {{0, 0}},");
+        line("    }};");
+        line("");
+        line("    class program final : public aoc::compiled_program {{");
+        line("    public:");
+        line("        program() : aoc::compiled_program(image, code_words, std::size(image), blocks, {}) {{}}", blocks.size());
+        line("");
+        line("        std::unique_ptr<aoc::computer::accelerator> clone() const override {{");
+        line("            return std::make_unique<program>();");
+        line("        }}");
+        line("");
+        line("        void run(aoc::computer& c) override {{");
+        line("            auto& m = memory_of(c);");
+        line("            auto& ip = register_ref(c, aoc::computer::RC_IP);");
+        line("            auto& rb = register_ref(c, aoc::computer::RC_RELBASE);");
+        line("            (void)m; (void)rb;");
+        line("");
+        line("        dispatch:");
+        line("            switch (ip) {{");
+        for (const auto& b : blocks)
+            line("                case {}: goto b_{};", b.start, b.start);
+        line("                default: return;");
+        line("            }}");
+        for (size_t idx = 0; idx < blocks.size(); idx++)
+            emit_block(blocks[idx], idx, block_at);
+        line("        }}");
+        line("    }};");
+        line("}}");
+        line("");
+        line("std::unique_ptr<aoc::computer::accelerator> aoc::make_compiled_program() {{");
+        line("    return std::make_unique<program>();");
+        line("}}");
+        return std::move(out_);
+    }
+
+private:
+    template <typename... Args>
+    inline void line(std::string_view fmt_str, const Args&... args) {
+        out_ += fmt::vformat(fmt_str, fmt::make_format_args(args...));
+        out_ += '\n';
+    }
+
+    static inline std::string literal(memory_value_t v) {
+        if (v == std::numeric_limits<memory_value_t>::min())
+            return "std::numeric_limits<memory_value_t>::min()";
+        return fmt::format("{}", v);
+    }
+
+    static inline std::string_view mnemonic(aoc::computer::instruction_code code) {
+        switch (code) {
+            case aoc::computer::OP_ADD: return "ADD";
+            case aoc::computer::OP_MUL: return "MUL";
+            case aoc::computer::OP_JNZ: return "JNZ";
+            case aoc::computer::OP_JZ: return "JZ";
+            case aoc::computer::OP_LT: return "LT";
+            case aoc::computer::OP_EQ: return "EQ";
+            case aoc::computer::OP_SRB: return "SRB";
+            default: return "???";
+        }
+    }
+
+    void load(const instruction& ins, size_t p, std::string_view dst) {
+        auto v = ins.params[p];
+        switch (ins.modes[p]) {
+            case aoc::computer::AM_IMMEDIATE:
+                line("                {} = {};", dst, literal(v));
+                break;
+            case aoc::computer::AM_POSITION:
+                if (v < 0) {
+                    line("                AOC_LEAVE({});", ins.addr);
+                    break;
+                }
+                line("                {} = m.read({});", dst, v);
+                break;
+            default:
+                line("                {} = m.read(rb + {});", dst, literal(v));
+                break;
+        }
+    }
+
+    void store(const instruction& ins, std::string_view value) {
+        auto v = ins.params[2];
+        if (ins.modes[2] == aoc::computer::AM_POSITION) {
+            if (v < 0) {
+                line("                AOC_LEAVE({});", ins.addr);
+                return;
+            }
+            line("                if (is_code({})) AOC_LEAVE({});", v, ins.addr);
+            line("                m.write({}, {});", v, value);
+            line("                drop_decoded(c, {});", v);
+        } else {
+            line("                auto a = rb + {};", literal(v));
+            line("                if (a < 0 || is_code(a)) AOC_LEAVE({});", ins.addr);
+            line("                m.write(a, {});", value);
+            line("                drop_decoded(c, size_t(a));");
+        }
+    }
+
+    void jump_to(size_t target, const std::map<size_t, size_t>& block_at, std::string_view indent) {
+        if (block_at.count(target))
+            line("{}goto b_{};", indent, target);
+        else
+            line("{}AOC_LEAVE({});", indent, target);
+    }
+
+    void emit_block(const block& b, size_t idx, const std::map<size_t, size_t>& block_at) {
+        line("");
+        line("        b_{}:", b.start);
+        line("            if (!enter(c, {})) AOC_LEAVE({});", idx, b.start);
+        for (const auto& ins : b.body) {
+            line("            /* {}: {} */", ins.addr, mnemonic(ins.code));
+            bool direct_jump = ins.is_jump() && ins.modes[1] == aoc::computer::AM_IMMEDIATE && ins.params[1] >= 0;
+            line("            {{");
+            line("                memory_value_t v0{{}};");
+            load(ins, 0, "v0");
+            if (ins.length > 2 && !direct_jump) {
+                line("                memory_value_t v1{{}};");
+                load(ins, 1, "v1");
+            }
+            switch (ins.code) {
+                case aoc::computer::OP_ADD:
+                    store(ins, "memory_value_t(uint64_t(v0) + uint64_t(v1))");
+                    break;
+                case aoc::computer::OP_MUL:
+                    store(ins, "memory_value_t(uint64_t(v0) * uint64_t(v1))");
+                    break;
+                case aoc::computer::OP_LT:
+                    store(ins, "v0 < v1 ? 1 : 0");
+                    break;
+                case aoc::computer::OP_EQ:
+                    store(ins, "v0 == v1 ? 1 : 0");
+                    break;
+                case aoc::computer::OP_SRB:
+                    line("                rb += v0;");
+                    break;
+                case aoc::computer::OP_JNZ: [[fallthrough]];
+                case aoc::computer::OP_JZ: {
+                    line("                if ({}v0) {{", ins.code == aoc::computer::OP_JZ ? "!" : "");
+                    if (direct_jump) {
+                        jump_to(size_t(ins.params[1]), block_at, "                    ");
+                    } else {
+                        line("                    ip = v1;");
+                        line("                    goto dispatch;");
+                    }
+                    line("                }}");
+                    break;
+                }
+                default: std::abort();
+            }
+            line("            }}");
+        }
+        jump_to(b.next, block_at, "            ");
+    }
+
+    const disassembler& dis_;
+    std::string_view source_;
+    std::string out_{};
+};
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fmt::print(::stderr, "usage: {} <image> <output.cpp>\n", argv[0]);
+        return 1;
+    }
+
+    std::ifstream in(argv[1]);
+    if (!in) {
+        fmt::print(::stderr, "cannot open {}\n", argv[1]);
+        return 1;
+    }
+    auto c = aoc::computer::read_initial_state(in);
+
+    disassembler dis(c.memory().to_vector());
+    dis.run();
+    auto code = emitter(dis, argv[1]).generate();
+
+    std::ofstream out(argv[2], std::ios::trunc);
+    out << code;
+    if (!out) {
+        fmt::print(::stderr, "cannot write {}\n", argv[2]);
+        return 1;
+    }
+
+    return 0;
+}